@@ -0,0 +1,110 @@
+/*
+ * protocol.h
+ *
+ * Created: 16.10.2026
+ *
+ * Master to Slave frames. Every TWI write carries one frame:
+ *
+ *   seq | len | command... | crc
+ *
+ * seq counts frames per car, len is the number of command bytes and crc
+ * is the CRC-8 (polynomial 0x07, _crc8_ccitt_update) of seq, len and the
+ * commands. A command is an opcode followed by proto_arg_len(opcode)
+ * argument bytes, several commands are packed into one frame. seq 0 is
+ * sent by a Master that has just booted and is always accepted, the Slave
+ * drops any other frame that repeats the previous seq (a retransmission).
+ *
+ * Frames to the TWI general call address reach every landing indicator at
+ * once; the car Slaves do not answer the general call. They have a seq of
+ * their own and only carry PROTO_POSITION, which each indicator filters
+ * for the car it shows. With no indicators on the bus nobody ACKs them.
+ *
+ * A TWI read returns the Slave's status block, PROTO_STATUS_LEN bytes
+ * with 16-bit counters little endian and a CRC-8 over the rest. The Slave
+ * builds it in advance, so the read never waits for the Slave's main loop.
+ *
+ * A Slave pulls the shared attention line low when it has news: its
+ * effects are over and every frame is carried out, or an error counter
+ * went up. Reading its status block returns the reason and releases it.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+
+#define PROTO_PAYLOAD_MAX 8
+#define PROTO_OVERHEAD 3 // seq, len, crc
+#define PROTO_FRAME_MAX (PROTO_PAYLOAD_MAX + PROTO_OVERHEAD)
+#define PROTO_SEQ_RESYNC 0
+#define PROTO_GENERAL_CALL 0x00 // TWI address of a broadcast
+
+// Opcodes, arguments in brackets
+#define PROTO_MOVE_ON 0x01
+#define PROTO_MOVE_OFF 0x02
+#define PROTO_BLINK 0x03	 // [count] movement LED blinks, FAULT
+#define PROTO_DOOR_OPEN 0x04
+#define PROTO_DOOR_CLOSE 0x05
+#define PROTO_EMERGENCY 0x06 // [notes] of the rising emergency melody
+#define PROTO_SET_PARAM 0x07 // [param, value low, value high], kept in the Slave EEPROM
+#define PROTO_MEM_REPORT 0x08 // Slave prints its RAM use and TWI errors on its own UART
+#define PROTO_POSITION 0x09	  // [car, floor, PROTO_DIR_*], general call only
+
+#define PROTO_DIR_NONE 0
+#define PROTO_DIR_UP 1
+#define PROTO_DIR_DOWN 2
+
+// Slave parameters set with PROTO_SET_PARAM
+#define PROTO_PARAM_BLINK 0 // ms per half period of the fault blink
+#define PROTO_PARAM_NOTE 1	// ms per note of the emergency melody
+#define PROTO_PARAM_HOLD 2	// ms the door LED stays on after the melody
+#define PROTO_PARAM_COUNT 3
+#define PROTO_PARAM_NONE 0xFF
+
+// Status block, byte offsets
+#define PROTO_STATUS_OUTPUTS 0	  // PROTO_OUT_* bits as driven now
+#define PROTO_STATUS_EFFECT 1	  // PROTO_EFFECT_* running
+#define PROTO_STATUS_SEQ 2		  // seq of the last frame carried out
+#define PROTO_STATUS_QUEUED 3	  // Frames received and not carried out yet
+#define PROTO_STATUS_BAD_FRAMES 4 // Length, CRC or command errors
+#define PROTO_STATUS_DROPPED 6	  // Frames longer than PROTO_FRAME_MAX
+#define PROTO_STATUS_BUS_ERRORS 8 // Illegal START or STOP
+#define PROTO_STATUS_TIMEOUTS 10  // Frames the Master abandoned halfway
+#define PROTO_STATUS_ATTENTION 12 // PROTO_ATTN_* raised since the last read
+#define PROTO_STATUS_CRC 13
+#define PROTO_STATUS_LEN 14
+
+#define PROTO_OUT_MOVE 0x01	  // Movement LED
+#define PROTO_OUT_DOOR 0x02	  // Door LED
+#define PROTO_OUT_BUZZER 0x04 // Emergency melody sounding
+
+#define PROTO_EFFECT_NONE 0
+#define PROTO_EFFECT_BLINK 1	 // PROTO_BLINK
+#define PROTO_EFFECT_EMERGENCY 2 // PROTO_EMERGENCY, melody and door hold
+
+#define PROTO_ATTN_DONE 0x01  // An effect ended and the Slave is idle
+#define PROTO_ATTN_FAULT 0x02 // An error counter went up
+
+// Argument bytes after opcode, 0xFF for an unknown opcode
+static inline uint8_t proto_arg_len(uint8_t opcode)
+{
+	switch (opcode)
+	{
+	case PROTO_MOVE_ON:
+	case PROTO_MOVE_OFF:
+	case PROTO_DOOR_OPEN:
+	case PROTO_DOOR_CLOSE:
+	case PROTO_MEM_REPORT:
+		return 0;
+	case PROTO_BLINK:
+	case PROTO_EMERGENCY:
+		return 1;
+	case PROTO_SET_PARAM:
+	case PROTO_POSITION:
+		return 3;
+	default:
+		return 0xFF;
+	}
+}
+
+#endif // PROTOCOL_H
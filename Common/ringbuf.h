@@ -0,0 +1,135 @@
+/*
+ * ringbuf.h
+ *
+ * Created: 16.10.2026
+ *
+ * Lock-free single-producer/single-consumer ring buffer, shared by the
+ * Master and the Slave for handing data between an ISR and the main loop.
+ * RINGBUF_DEFINE(name, type, size) declares the type name_t and static
+ * inline name_xxx() functions for it.
+ *
+ * head and tail are free-running 8-bit counters: head is only written by
+ * the producer, tail only by the consumer, and head - tail is the fill
+ * level. A single byte store is atomic on AVR, so neither side ever needs
+ * to disable interrupts. The compiler barriers make sure the element is
+ * stored before head publishes it, and read before tail releases it.
+ *
+ * size must be a power of two, at most 128, and every slot is usable.
+ * test/ringbuf_test.c stresses it on the host with two threads.
+ */
+
+#ifndef RINGBUF_H
+#define RINGBUF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Keeps the compiler from moving memory accesses across this point. AVR has
+// a single core and no store buffer, so nothing more is needed.
+#define RINGBUF_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+#define RINGBUF_DEFINE(name, type, size)                                                                     \
+	_Static_assert(((size) & ((size) - 1)) == 0, #name " size must be a power of two");                     \
+	_Static_assert(((size) > 0) && ((size) <= 128), #name " size must be 1..128");                          \
+                                                                                                             \
+	typedef struct                                                                                           \
+	{                                                                                                        \
+		type items[size];                                                                                    \
+		volatile uint8_t head; /* Written by the producer */                                                 \
+		volatile uint8_t tail; /* Written by the consumer */                                                 \
+	} name##_t;                                                                                              \
+                                                                                                             \
+	/* Only while neither side is running */                                                                 \
+	static inline void name##_init(name##_t *r)                                                              \
+	{                                                                                                        \
+		r->head = 0;                                                                                         \
+		r->tail = 0;                                                                                         \
+	}                                                                                                        \
+                                                                                                             \
+	/* Either side, the value may already be stale when it returns */                                        \
+	static inline uint8_t name##_count(const name##_t *r)                                                    \
+	{                                                                                                        \
+		return (uint8_t)(r->head - r->tail);                                                                 \
+	}                                                                                                        \
+                                                                                                             \
+	static inline uint8_t name##_space(const name##_t *r)                                                    \
+	{                                                                                                        \
+		return (size) - name##_count(r);                                                                     \
+	}                                                                                                        \
+                                                                                                             \
+	static inline bool name##_empty(const name##_t *r)                                                       \
+	{                                                                                                        \
+		return r->head == r->tail;                                                                           \
+	}                                                                                                        \
+                                                                                                             \
+	/* Producer. Returns false and drops item if the buffer is full. */                                      \
+	static inline bool name##_push(name##_t *r, type item)                                                   \
+	{                                                                                                        \
+		uint8_t head = r->head;                                                                              \
+                                                                                                             \
+		if ((uint8_t)(head - r->tail) >= (size))                                                             \
+		{                                                                                                    \
+			return false;                                                                                    \
+		}                                                                                                    \
+		r->items[head & ((size) - 1)] = item;                                                                \
+		RINGBUF_BARRIER(); /* Item in place before it is published */                                        \
+		r->head = head + 1;                                                                                  \
+		return true;                                                                                         \
+	}                                                                                                        \
+                                                                                                             \
+	/* Producer. Free slot to fill in place, NULL if full. Nothing is */                                     \
+	/* published until commit, reserving again returns the same slot. */                                     \
+	static inline type *name##_reserve(name##_t *r)                                                          \
+	{                                                                                                        \
+		uint8_t head = r->head;                                                                              \
+                                                                                                             \
+		if ((uint8_t)(head - r->tail) >= (size))                                                             \
+		{                                                                                                    \
+			return NULL;                                                                                     \
+		}                                                                                                    \
+		return &r->items[head & ((size) - 1)];                                                               \
+	}                                                                                                        \
+                                                                                                             \
+	/* Producer. Publishes the slot filled after reserve. */                                                 \
+	static inline void name##_commit(name##_t *r)                                                            \
+	{                                                                                                        \
+		RINGBUF_BARRIER(); /* Item in place before it is published */                                        \
+		r->head = r->head + 1;                                                                               \
+	}                                                                                                        \
+                                                                                                             \
+	/* Consumer. Oldest item without removing it, NULL if empty. */                                          \
+	static inline type *name##_peek(name##_t *r)                                                             \
+	{                                                                                                        \
+		uint8_t tail = r->tail;                                                                              \
+                                                                                                             \
+		if (tail == r->head)                                                                                 \
+		{                                                                                                    \
+			return NULL;                                                                                     \
+		}                                                                                                    \
+		RINGBUF_BARRIER(); /* No reading the item before head said it is there */                            \
+		return &r->items[tail & ((size) - 1)];                                                               \
+	}                                                                                                        \
+                                                                                                             \
+	/* Consumer. Removes the item returned by peek. */                                                       \
+	static inline void name##_drop(name##_t *r)                                                              \
+	{                                                                                                        \
+		RINGBUF_BARRIER(); /* Done with the item before the producer may reuse it */                         \
+		r->tail = r->tail + 1;                                                                               \
+	}                                                                                                        \
+                                                                                                             \
+	/* Consumer. Returns false if the buffer is empty. */                                                    \
+	static inline bool name##_pop(name##_t *r, type *item)                                                   \
+	{                                                                                                        \
+		type *oldest = name##_peek(r);                                                                       \
+                                                                                                             \
+		if (oldest == NULL)                                                                                  \
+		{                                                                                                    \
+			return false;                                                                                    \
+		}                                                                                                    \
+		*item = *oldest;                                                                                     \
+		name##_drop(r);                                                                                      \
+		return true;                                                                                         \
+	}
+
+#endif // RINGBUF_H
@@ -0,0 +1,124 @@
+/*
+ * ringbuf_test.c
+ *
+ * Created: 17.10.2026
+ *
+ * Host stress test of ringbuf.h: a producer thread pushes a counting
+ * sequence and the consumer checks that every value arrives once, in
+ * order, and that the fill level never leaves 0..size. A small buffer
+ * makes head and tail wrap often and keeps both sides at the full and
+ * empty edges.
+ *
+ * RINGBUF_BARRIER() is only a compiler barrier, which is enough on AVR
+ * and on hosts with ordered stores such as x86. On a weakly ordered host
+ * this test may fail although the AVR code is correct.
+ *
+ * Build and run with "make test" in this directory.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../ringbuf.h"
+
+#define TEST_SIZE 4
+#define TEST_ITEMS 5000000UL
+
+RINGBUF_DEFINE(testq, uint32_t, TEST_SIZE)
+
+static testq_t queue;
+
+static void *producer(void *arg)
+{
+	(void)arg;
+	uint32_t *slot;
+
+	for (uint32_t i = 0; i < TEST_ITEMS;)
+	{
+		// Alternate between push and reserve/commit so both producer paths run
+		if (i & 1)
+		{
+			slot = testq_reserve(&queue);
+			if (slot == NULL)
+			{
+				sched_yield();
+				continue;
+			}
+			*slot = i++;
+			testq_commit(&queue);
+		}
+		else if (testq_push(&queue, i))
+		{
+			i++;
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t thread;
+	uint32_t expected = 0;
+	uint32_t value;
+	uint32_t *oldest;
+	uint8_t count;
+
+	testq_init(&queue);
+	if (pthread_create(&thread, NULL, producer, NULL) != 0)
+	{
+		perror("pthread_create");
+		return EXIT_FAILURE;
+	}
+
+	while (expected < TEST_ITEMS)
+	{
+		count = testq_count(&queue);
+		if (count > TEST_SIZE)
+		{
+			printf("FAIL: count %u above size %u\n", count, TEST_SIZE);
+			return EXIT_FAILURE;
+		}
+
+		// Alternate between pop and peek/drop so both consumer paths run
+		if (expected & 1)
+		{
+			if (!testq_pop(&queue, &value))
+			{
+				sched_yield();
+				continue;
+			}
+		}
+		else
+		{
+			oldest = testq_peek(&queue);
+			if (oldest == NULL)
+			{
+				sched_yield();
+				continue;
+			}
+			value = *oldest;
+			testq_drop(&queue);
+		}
+
+		if (value != expected)
+		{
+			printf("FAIL: got %lu, expected %lu\n", (unsigned long)value, (unsigned long)expected);
+			return EXIT_FAILURE;
+		}
+		expected++;
+	}
+
+	pthread_join(thread, NULL);
+	if (!testq_empty(&queue))
+	{
+		printf("FAIL: %u items left over\n", testq_count(&queue));
+		return EXIT_FAILURE;
+	}
+	printf("ringbuf: %lu items in order\n", (unsigned long)expected);
+	return EXIT_SUCCESS;
+}
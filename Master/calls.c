@@ -0,0 +1,285 @@
+/*
+ * calls.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "calls.h"
+#include <avr/pgmspace.h>
+
+#define FLOOR_BIT(f) ((FloorMask)1 << (f))
+
+// Index of the lowest/highest set bit in a nibble, entry 0 is unused
+static const uint8_t lowestBit[16] PROGMEM = {0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0};
+static const uint8_t highestBit[16] PROGMEM = {0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3};
+
+// Floors strictly above / below floor
+static inline FloorMask above(uint8_t floor)
+{
+	return ~((FLOOR_BIT(floor) << 1) - 1);
+}
+
+static inline FloorMask below(uint8_t floor)
+{
+	return FLOOR_BIT(floor) - 1;
+}
+
+// Lowest floor in a non-empty mask, at most four byte steps
+static uint8_t lowest_floor(FloorMask mask)
+{
+	uint8_t base = 0;
+
+	while ((uint8_t)mask == 0)
+	{
+		mask >>= 8;
+		base += 8;
+	}
+
+	uint8_t b = (uint8_t)mask;
+
+	if (b & 0x0F)
+	{
+		return base + pgm_read_byte(&lowestBit[b & 0x0F]);
+	}
+	return base + 4 + pgm_read_byte(&lowestBit[b >> 4]);
+}
+
+// Highest floor in a non-empty mask
+static uint8_t highest_floor(FloorMask mask)
+{
+	uint8_t base = 24;
+
+	while ((uint8_t)(mask >> 24) == 0)
+	{
+		mask <<= 8;
+		base -= 8;
+	}
+
+	uint8_t b = (uint8_t)(mask >> 24);
+
+	if (b & 0xF0)
+	{
+		return base + 4 + pgm_read_byte(&highestBit[b >> 4]);
+	}
+	return base + pgm_read_byte(&highestBit[b & 0x0F]);
+}
+
+void calls_init(CallRegistry *calls)
+{
+	calls->car = 0;
+	calls->hallUp = 0;
+	calls->hallDown = 0;
+}
+
+bool calls_add(CallRegistry *calls, uint8_t call)
+{
+	uint8_t floor = call & CALL_FLOOR_MASK;
+
+	if (floor >= FLOOR_COUNT)
+	{
+		return false;
+	}
+
+	switch (call & CALL_TYPE_MASK)
+	{
+	case CALL_HALL_UP:
+		calls->hallUp |= FLOOR_BIT(floor);
+		break;
+	case CALL_HALL_DOWN:
+		calls->hallDown |= FLOOR_BIT(floor);
+		break;
+	default:
+		calls->car |= FLOOR_BIT(floor);
+		break;
+	}
+	return true;
+}
+
+bool calls_pending(const CallRegistry *calls)
+{
+	return (calls->car | calls->hallUp | calls->hallDown) != 0;
+}
+
+// Next stop in one direction only. Calls travelling with the car are taken
+// first, then the farthest call against it, where the car turns around.
+static bool next_in_direction(const CallRegistry *calls, uint8_t floor, Direction dir, uint8_t *stop)
+{
+	FloorMask with, against;
+
+	if (dir == DIR_UP)
+	{
+		with = (calls->car | calls->hallUp) & above(floor);
+		against = calls->hallDown & above(floor);
+		if (with)
+		{
+			*stop = lowest_floor(with);
+			return true;
+		}
+		if (against)
+		{
+			*stop = highest_floor(against);
+			return true;
+		}
+	}
+	else
+	{
+		with = (calls->car | calls->hallDown) & below(floor);
+		against = calls->hallUp & below(floor);
+		if (with)
+		{
+			*stop = highest_floor(with);
+			return true;
+		}
+		if (against)
+		{
+			*stop = lowest_floor(against);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool calls_next_stop(const CallRegistry *calls, uint8_t floor, Direction *dir, uint8_t *stop)
+{
+	FloorMask all = calls->car | calls->hallUp | calls->hallDown;
+	Direction first = (*dir == DIR_DOWN) ? DIR_DOWN : DIR_UP;
+	Direction second = (first == DIR_UP) ? DIR_DOWN : DIR_UP;
+
+	if (all == 0)
+	{
+		*dir = DIR_NONE;
+		return false;
+	}
+
+	if (next_in_direction(calls, floor, first, stop))
+	{
+		*dir = first;
+		return true;
+	}
+	if (next_in_direction(calls, floor, second, stop))
+	{
+		*dir = second;
+		return true;
+	}
+	return false;
+}
+
+bool calls_stop_here(const CallRegistry *calls, uint8_t floor, Direction dir)
+{
+	FloorMask bit = FLOOR_BIT(floor);
+	uint8_t stop;
+
+	if (dir == DIR_NONE)
+	{
+		return ((calls->car | calls->hallUp | calls->hallDown) & bit) != 0; // Car at rest serves any call
+	}
+
+	if ((calls->car & bit) || ((dir == DIR_UP) && (calls->hallUp & bit)) ||
+		((dir == DIR_DOWN) && (calls->hallDown & bit)))
+	{
+		return true;
+	}
+
+	// Stop for a call against the travel direction only if nothing lies beyond it
+	if ((calls->hallUp | calls->hallDown) & bit)
+	{
+		return !next_in_direction(calls, floor, dir, &stop);
+	}
+	return false;
+}
+
+bool calls_has(const CallRegistry *calls, uint8_t call)
+{
+	uint8_t floor = call & CALL_FLOOR_MASK;
+
+	if (floor >= FLOOR_COUNT)
+	{
+		return false;
+	}
+
+	switch (call & CALL_TYPE_MASK)
+	{
+	case CALL_HALL_UP:
+		return (calls->hallUp & FLOOR_BIT(floor)) != 0;
+	case CALL_HALL_DOWN:
+		return (calls->hallDown & FLOOR_BIT(floor)) != 0;
+	default:
+		return (calls->car & FLOOR_BIT(floor)) != 0;
+	}
+}
+
+uint8_t calls_between(const CallRegistry *calls, uint8_t from, uint8_t to)
+{
+	FloorMask mask = calls->car | calls->hallUp | calls->hallDown;
+	uint8_t n = 0;
+
+	mask &= (from < to) ? (above(from) & below(to)) : (above(to) & below(from));
+	while (mask)
+	{
+		mask &= mask - 1; // Clear the lowest set bit
+		n++;
+	}
+	return n;
+}
+
+uint8_t calls_farthest(const CallRegistry *calls, uint8_t floor, Direction dir)
+{
+	FloorMask mask = calls->car | calls->hallUp | calls->hallDown;
+
+	if (dir == DIR_UP)
+	{
+		mask &= above(floor);
+		return mask ? highest_floor(mask) : floor;
+	}
+	if (dir == DIR_DOWN)
+	{
+		mask &= below(floor);
+		return mask ? lowest_floor(mask) : floor;
+	}
+	return floor;
+}
+
+bool calls_hall_at(const CallRegistry *calls, uint8_t floor)
+{
+	return ((calls->hallUp | calls->hallDown) & FLOOR_BIT(floor)) != 0;
+}
+
+Direction calls_serve(CallRegistry *calls, uint8_t floor, Direction dir)
+{
+	FloorMask bit = FLOOR_BIT(floor);
+	uint8_t stop;
+
+	calls->car &= ~bit;
+
+	if (dir == DIR_DOWN)
+	{
+		calls->hallDown &= ~bit;
+	}
+	else
+	{
+		calls->hallUp &= ~bit;
+	}
+
+	if ((dir != DIR_NONE) && next_in_direction(calls, floor, dir, &stop))
+	{
+		return dir; // More to do the same way
+	}
+
+	// Turning around (or starting from rest): this stop also serves the other direction
+	if (dir == DIR_DOWN)
+	{
+		calls->hallUp &= ~bit;
+		dir = DIR_UP;
+	}
+	else
+	{
+		calls->hallDown &= ~bit;
+		dir = DIR_DOWN;
+	}
+
+	if (!calls_next_stop(calls, floor, &dir, &stop))
+	{
+		return DIR_NONE;
+	}
+	return dir;
+}
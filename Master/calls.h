@@ -0,0 +1,75 @@
+/*
+ * calls.h
+ *
+ * Created: 16.10.2026
+ *
+ * Registry of pending calls. Car calls and up/down hall calls are kept as
+ * one bit per floor, so registering, clearing and finding the next stop are
+ * a handful of mask operations whatever the number of pending calls.
+ * The next stop follows the LOOK policy: keep going in the travel direction
+ * while there are calls ahead, then turn around.
+ */
+
+#ifndef CALLS_H
+#define CALLS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLOOR_COUNT 32 // Floors 0..31, one bit each in a FloorMask
+
+// Call type is carried in the top bits of the EVT_KEY_CONFIRMED argument
+#define CALL_CAR 0x00
+#define CALL_HALL_UP 0x40
+#define CALL_HALL_DOWN 0x80
+#define CALL_TYPE_MASK 0xC0
+#define CALL_FLOOR_MASK 0x3F
+
+typedef uint32_t FloorMask;
+
+typedef enum
+{
+	DIR_NONE,
+	DIR_UP,
+	DIR_DOWN
+} Direction;
+
+typedef struct
+{
+	FloorMask car;		// Destinations entered in the car
+	FloorMask hallUp;	// Landing calls wanting to go up
+	FloorMask hallDown; // Landing calls wanting to go down
+} CallRegistry;
+
+void calls_init(CallRegistry *calls);
+
+// Register a call encoded as CALL_xxx | floor. Returns false for a floor out of range.
+bool calls_add(CallRegistry *calls, uint8_t call);
+bool calls_pending(const CallRegistry *calls);
+
+// Next floor to stop at after leaving floor in *dir, calls on floor itself are
+// not considered (see calls_stop_here). Updates *dir to the direction of that
+// stop. Returns false if there are no calls anywhere else.
+bool calls_next_stop(const CallRegistry *calls, uint8_t floor, Direction *dir, uint8_t *stop);
+
+// True if the car at floor travelling in dir has to stop there. With DIR_NONE
+// (car at rest) any call on the floor counts.
+bool calls_stop_here(const CallRegistry *calls, uint8_t floor, Direction dir);
+
+// True if the call encoded as CALL_xxx | floor is already registered
+bool calls_has(const CallRegistry *calls, uint8_t call);
+
+// Number of floors strictly between from and to that have a call
+uint8_t calls_between(const CallRegistry *calls, uint8_t from, uint8_t to);
+
+// Farthest floor with a call beyond floor in dir, floor itself if there is none
+uint8_t calls_farthest(const CallRegistry *calls, uint8_t floor, Direction dir);
+
+// True if a hall call (either direction) is waiting at floor
+bool calls_hall_at(const CallRegistry *calls, uint8_t floor);
+
+// Clear the calls served by stopping at floor. Returns the direction the car
+// leaves in, DIR_NONE when nothing is left to serve.
+Direction calls_serve(CallRegistry *calls, uint8_t floor, Direction dir);
+
+#endif // CALLS_H
@@ -0,0 +1,116 @@
+/*
+ * checkpoint.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "checkpoint.h"
+#include "eeprom_map.h"
+#include "timer.h"
+#include "eventlog.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <string.h>
+
+typedef struct
+{
+	uint8_t seq; // Newest record has the highest sequence number (mod 256)
+	uint8_t crc; // CRC-8 of seq and cars
+	CarCheckpoint cars[CAR_COUNT];
+} Record;
+
+#define SLOT_COUNT (EEPROM_CHECKPOINT_SIZE / sizeof(Record))
+#define SLOT_ADDR(slot) (EEPROM_CHECKPOINT_START + (uint16_t)(slot) * sizeof(Record))
+
+_Static_assert(SLOT_COUNT >= 2, "Checkpoint region too small for CAR_COUNT");
+
+static Record current;	   // State as the FSM last reported it
+static Record writing;	   // Record being written, stable while the write runs
+static uint8_t nextSlot = 0;
+static uint8_t writeIndex = sizeof(Record); // Bytes of writing already sent, sizeof = idle
+static bool dirty = false;
+static uint32_t lastWrite = 0;
+
+static uint8_t crc8(const Record *r)
+{
+	const uint8_t *p = (const uint8_t *)r->cars;
+	uint8_t crc = _crc8_ccitt_update(0, r->seq);
+
+	for (uint8_t i = 0; i < sizeof(r->cars); i++)
+	{
+		crc = _crc8_ccitt_update(crc, p[i]);
+	}
+	return crc;
+}
+
+bool checkpoint_load(CarCheckpoint saved[CAR_COUNT])
+{
+	Record r;
+	bool found = false;
+	uint8_t newest = 0;
+
+	for (uint8_t slot = 0; slot < SLOT_COUNT; slot++)
+	{
+		eeprom_read_block(&r, EEPROM_ADDR(SLOT_ADDR(slot)), sizeof(r));
+		if (((r.seq == 0xFF) && (r.crc == 0xFF)) || (crc8(&r) != r.crc) || // Erased or torn
+			(found && ((int8_t)(r.seq - current.seq) <= 0)))
+		{
+			continue;
+		}
+		current = r;
+		newest = slot;
+		found = true;
+	}
+
+	if (!found)
+	{
+		memset(&current, 0, sizeof(current));
+		nextSlot = 0;
+		return false;
+	}
+	nextSlot = (newest + 1) % SLOT_COUNT;
+	memcpy(saved, current.cars, sizeof(current.cars));
+	return true;
+}
+
+void checkpoint_update(uint8_t car, const CarCheckpoint *state)
+{
+	if (memcmp(&current.cars[car], state, sizeof(*state)) != 0)
+	{
+		current.cars[car] = *state;
+		dirty = true;
+	}
+}
+
+bool checkpoint_calls_changed(uint8_t car, const CallRegistry *calls)
+{
+	return memcmp(&current.cars[car].calls, calls, sizeof(*calls)) != 0;
+}
+
+void checkpoint_task(void)
+{
+	if (writeIndex < sizeof(Record))
+	{
+		eventlog_suspend(); // Shares the EEPROM with the log interrupt
+		if (eeprom_is_ready()) // Previous byte done, about 3.4 ms each
+		{
+			eeprom_update_byte(EEPROM_ADDR(SLOT_ADDR(nextSlot) + writeIndex), ((const uint8_t *)&writing)[writeIndex]);
+			if (++writeIndex == sizeof(Record))
+			{
+				nextSlot = (nextSlot + 1) % SLOT_COUNT;
+			}
+		}
+		eventlog_resume();
+		return;
+	}
+
+	if (dirty && ((timer_millis() - lastWrite) >= CHECKPOINT_MIN_INTERVAL_MS))
+	{
+		current.seq++;
+		current.crc = crc8(&current);
+		writing = current;
+		writeIndex = 0;
+		dirty = false;
+		lastWrite = timer_millis();
+	}
+}
@@ -0,0 +1,51 @@
+/*
+ * checkpoint.h
+ *
+ * Created: 16.10.2026
+ *
+ * Controller state kept in EEPROM so a reset (watchdog or power) resumes
+ * where the cars were instead of homing them. Records carry a sequence
+ * number and a CRC and are written round robin over a ring of slots, so a
+ * torn write falls back to the previous record and the wear is spread over
+ * the whole region.
+ *
+ * Wear: the FSM only reports resting states (door cycles at a floor and
+ * changes to the calls), not every floor passed, and changes within
+ * CHECKPOINT_MIN_INTERVAL_MS share one write. Each write reprograms at
+ * least the seq and CRC bytes of one slot, so under changes that never
+ * stop a slot is rewritten every SLOT_COUNT minutes (16 with one car, 8
+ * with two). The 100k cycle endurance then lasts about 3 years (1.5 with
+ * two cars); at a few busy hours a day it is well over 10 years. A reset
+ * loses at most the last minute of calls.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "calls.h"
+#include "slave_comm.h"
+
+#define CHECKPOINT_MIN_INTERVAL_MS 60000UL // Changes within this time share one write, see the wear note above
+
+typedef struct
+{
+	uint8_t floor;
+	uint8_t doorOpen;
+	CallRegistry calls;
+} CarCheckpoint;
+
+// Fills saved from the newest valid record, false if there is none
+bool checkpoint_load(CarCheckpoint saved[CAR_COUNT]);
+
+// New state of car, only a difference to the last one schedules a write
+void checkpoint_update(uint8_t car, const CarCheckpoint *state);
+
+// The calls of car differ from the ones last reported
+bool checkpoint_calls_changed(uint8_t car, const CallRegistry *calls);
+
+// Writes a pending record one byte per call, never waits for the EEPROM
+void checkpoint_task(void); // Every scheduler pass
+
+#endif // CHECKPOINT_H
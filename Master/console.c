@@ -0,0 +1,450 @@
+/*
+ * console.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "console.h"
+#include "calls.h"
+#include "events.h"
+#include "elevator.h"
+#include "stats.h"
+#include "eventlog.h"
+#include "params.h"
+#include "stack.h"
+#include "slave_comm.h"
+#include "prof.h"
+#include "idle.h"
+#include "traffic.h"
+#include "emergency.h"
+#include "../Common/ringbuf.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RX_PER_PASS 8 // Bytes taken from the RX buffer per scheduler pass
+#define STATE_IDLE 0xFF
+#define PARAMS_IDLE 0xFF
+#define HELP_IDLE 0xFF
+
+typedef struct
+{
+	PGM_P name;
+	PGM_P help;
+	void (*run)(char *args);
+} Command;
+
+RINGBUF_DEFINE(rxbuf, uint8_t, CONSOLE_RX_SIZE);
+
+static rxbuf_t rx; // Filled by the ISR, emptied by console_task()
+static volatile bool rxOverrun = false;
+
+static char line[CONSOLE_LINE_SIZE];
+static uint8_t lineLen = 0;
+static bool lineTooLong = false;
+static uint8_t verbosity = CONSOLE_DEFAULT_VERBOSITY;
+static uint8_t stateLine = STATE_IDLE; // Next car printed by "state"
+static uint8_t paramLine = PARAMS_IDLE; // Next parameter printed by "get"
+static uint8_t helpLine = HELP_IDLE;	// Next command printed by "help"
+
+ISR(USART0_RX_vect)
+{
+	if (!rxbuf_push(&rx, UDR0)) // Reading UDR0 clears the interrupt, even when dropped
+	{
+		rxOverrun = true;
+	}
+}
+
+// Parses a floor number, returns false if it is missing or out of range
+static bool parseFloor(char *args, uint8_t *floor)
+{
+	char *end;
+	unsigned long value = strtoul(args, &end, 10);
+
+	if ((end == args) || (value >= FLOOR_COUNT))
+	{
+		printf_P(PSTR("Floor 0..%u expected\n"), FLOOR_COUNT - 1);
+		return false;
+	}
+	*floor = (uint8_t)value;
+	return true;
+}
+
+static void postCall(char *args, uint8_t type)
+{
+	uint8_t floor;
+
+	if (parseFloor(args, &floor))
+	{
+		event_post(EVT_KEY_CONFIRMED, type | floor); // Same path as the keypad
+	}
+}
+
+static void cmdCar(char *args)
+{
+	postCall(args, CALL_CAR);
+}
+
+static void cmdUp(char *args)
+{
+	postCall(args, CALL_HALL_UP);
+}
+
+static void cmdDown(char *args)
+{
+	postCall(args, CALL_HALL_DOWN);
+}
+
+static void cmdEmergency(char *args)
+{
+	emergency_trigger(); // Same path as the button, counted and timed
+}
+
+static void cmdClear(char *args)
+{
+	event_post(EVT_KEY_PRESSED, 0); // Acknowledges an emergency or a fault like any key
+}
+
+static void cmdState(char *args)
+{
+	stateLine = 0;
+}
+
+static void cmdStats(char *args)
+{
+	stats_dump();
+}
+
+static void cmdLog(char *args)
+{
+	eventlog_dump();
+}
+
+static void cmdTrace(char *args)
+{
+	elevator_trace_dump();
+}
+
+static void cmdMem(char *args)
+{
+	stack_report();
+	for (uint8_t car = 0; car < CAR_COUNT; car++)
+	{
+		queueCommandToSlave(car, PROTO_MEM_REPORT);
+	}
+}
+
+#if PROFILE
+static void cmdProf(char *args)
+{
+	if (strcmp_P(args, PSTR("reset")) == 0)
+	{
+		prof_reset();
+		return;
+	}
+	prof_dump();
+}
+#endif
+
+static void cmdTwi(char *args)
+{
+	slave_report();
+}
+
+static void cmdPower(char *args)
+{
+	idle_report();
+}
+
+static void cmdVerbose(char *args)
+{
+	char *end;
+	unsigned long value = strtoul(args, &end, 10);
+
+	if ((end == args) || (value > CONSOLE_TRACE))
+	{
+		printf_P(PSTR("Verbosity %u\n"), verbosity);
+		return;
+	}
+	verbosity = (uint8_t)value;
+}
+
+static void cmdPolicy(char *args)
+{
+	TrafficPolicy policy;
+
+	if (*args == '\0')
+	{
+		printf_P(PSTR("Policy %S, %S in effect\n"), traffic_policy_name(traffic_selected_policy()),
+				 traffic_policy_name(traffic_policy()));
+		return;
+	}
+	policy = traffic_policy_find(args);
+	if (policy == POLICY_COUNT)
+	{
+		printf_P(PSTR("Unknown policy %s\n"), args);
+		return;
+	}
+	traffic_set_policy(policy);
+}
+
+static void cmdGet(char *args)
+{
+	ParamId id;
+
+	if (*args == '\0')
+	{
+		paramLine = 0; // All of them, one per pass
+		return;
+	}
+	id = params_find(args);
+	if (id == PARAM_NONE)
+	{
+		printf_P(PSTR("Unknown parameter %s\n"), args);
+		return;
+	}
+	printf_P(PSTR("%S %u\n"), params_name(id), param(id));
+}
+
+static void cmdSet(char *args)
+{
+	char *value = strchr(args, ' ');
+	char *end;
+	unsigned long number;
+	ParamId id;
+
+	if (value == NULL)
+	{
+		printf_P(PSTR("set <name> <value>\n"));
+		return;
+	}
+	*value++ = '\0';
+	id = params_find(args);
+	if (id == PARAM_NONE)
+	{
+		printf_P(PSTR("Unknown parameter %s\n"), args);
+		return;
+	}
+	if ((id == PARAM_FLOOR_HEIGHT) && !elevator_stopped())
+	{
+		printf_P(PSTR("%S can only change while every car is stopped\n"), params_name(id));
+		return;
+	}
+	number = strtoul(value, &end, 10);
+	if ((end == value) || (number > 0xFFFF) || !params_set(id, (uint16_t)number))
+	{
+		printf_P(PSTR("%S out of range\n"), params_name(id));
+	}
+}
+
+static void cmdHelp(char *args);
+
+static const char nameCar[] PROGMEM = "car";
+static const char nameUp[] PROGMEM = "up";
+static const char nameDown[] PROGMEM = "down";
+static const char nameEmergency[] PROGMEM = "emergency";
+static const char nameClear[] PROGMEM = "clear";
+static const char nameState[] PROGMEM = "state";
+static const char nameStats[] PROGMEM = "stats";
+static const char nameLog[] PROGMEM = "log";
+static const char nameTrace[] PROGMEM = "trace";
+static const char nameMem[] PROGMEM = "mem";
+static const char namePower[] PROGMEM = "power";
+static const char nameTwi[] PROGMEM = "twi";
+#if PROFILE
+static const char nameProf[] PROGMEM = "prof";
+#endif
+static const char nameVerbose[] PROGMEM = "verbose";
+static const char namePolicy[] PROGMEM = "policy";
+static const char nameGet[] PROGMEM = "get";
+static const char nameSet[] PROGMEM = "set";
+static const char nameHelp[] PROGMEM = "help";
+
+static const char helpCar[] PROGMEM = "<floor>  car call";
+static const char helpUp[] PROGMEM = "<floor>  hall call up";
+static const char helpDown[] PROGMEM = "<floor>  hall call down";
+static const char helpEmergency[] PROGMEM = "  stop all cars";
+static const char helpClear[] PROGMEM = "  acknowledge emergency or fault";
+static const char helpState[] PROGMEM = "  state of each car";
+static const char helpStats[] PROGMEM = "  runtime statistics";
+static const char helpLog[] PROGMEM = "  EEPROM event log";
+static const char helpTrace[] PROGMEM = "  recent FSM transitions";
+static const char helpMem[] PROGMEM = "  RAM use and stack high-water mark";
+static const char helpPower[] PROGMEM = "  duty cycle and current since the last report";
+static const char helpTwi[] PROGMEM = "  TWI errors by class and by car";
+#if PROFILE
+static const char helpProf[] PROGMEM = "[reset]  cycle counts of the profiled regions";
+#endif
+static const char helpVerbose[] PROGMEM = "[0-2]  quiet, info, trace";
+static const char helpPolicy[] PROGMEM = "[auto|look|lobby|zone]  parking policy of idle cars";
+static const char helpGet[] PROGMEM = "[name]  timing parameters";
+static const char helpSet[] PROGMEM = "<name> <value>  change and store a parameter";
+static const char helpHelp[] PROGMEM = "";
+
+static const Command commands[] PROGMEM = {
+	{nameCar, helpCar, cmdCar},
+	{nameUp, helpUp, cmdUp},
+	{nameDown, helpDown, cmdDown},
+	{nameEmergency, helpEmergency, cmdEmergency},
+	{nameClear, helpClear, cmdClear},
+	{nameState, helpState, cmdState},
+	{nameStats, helpStats, cmdStats},
+	{nameLog, helpLog, cmdLog},
+	{nameTrace, helpTrace, cmdTrace},
+	{nameMem, helpMem, cmdMem},
+	{namePower, helpPower, cmdPower},
+	{nameTwi, helpTwi, cmdTwi},
+#if PROFILE
+	{nameProf, helpProf, cmdProf},
+#endif
+	{nameVerbose, helpVerbose, cmdVerbose},
+	{namePolicy, helpPolicy, cmdPolicy},
+	{nameGet, helpGet, cmdGet},
+	{nameSet, helpSet, cmdSet},
+	{nameHelp, helpHelp, cmdHelp},
+};
+
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+static void cmdHelp(char *args)
+{
+	helpLine = 0;
+}
+
+static void printHelp(void)
+{
+	uint8_t i = helpLine;
+	Command cmd;
+
+	if (i == HELP_IDLE)
+	{
+		return;
+	}
+	helpLine = (i + 1 < COMMAND_COUNT) ? (i + 1) : HELP_IDLE;
+	memcpy_P(&cmd, &commands[i], sizeof(cmd));
+	printf_P(PSTR("%S %S\n"), cmd.name, cmd.help);
+}
+
+static void runLine(char *text)
+{
+	char *args;
+	Command cmd;
+
+	while (*text == ' ')
+	{
+		text++;
+	}
+	if (*text == '\0')
+	{
+		return;
+	}
+	args = strchr(text, ' ');
+	if (args != NULL)
+	{
+		*args++ = '\0';
+	}
+	else
+	{
+		args = text + strlen(text); // Empty argument string
+	}
+
+	for (uint8_t i = 0; i < COMMAND_COUNT; i++)
+	{
+		memcpy_P(&cmd, &commands[i], sizeof(cmd));
+		if (strcmp_P(text, cmd.name) == 0)
+		{
+			cmd.run(args);
+			return;
+		}
+	}
+	printf_P(PSTR("Unknown command %s, try help\n"), text);
+}
+
+// One car per pass, like the other multi-line reports
+static void printState(void)
+{
+	uint8_t car = stateLine;
+
+	if (car == STATE_IDLE)
+	{
+		return;
+	}
+	stateLine = (car + 1 < CAR_COUNT) ? (car + 1) : STATE_IDLE;
+	printf_P(PSTR("Car %u %S on %u\n"), car, elevator_state_name(elevator_state(car)), elevator_current_floor(car));
+}
+
+static void printParam(void)
+{
+	uint8_t id = paramLine;
+
+	if (id == PARAMS_IDLE)
+	{
+		return;
+	}
+	paramLine = (id + 1 < PARAM_COUNT) ? (id + 1) : PARAMS_IDLE;
+	printf_P(PSTR("%S %u\n"), params_name(id), param(id));
+}
+
+void console_init(void)
+{
+	UCSR0B |= (1 << RXCIE0);
+}
+
+void console_task(void)
+{
+	uint8_t c;
+
+	printState();
+	printParam();
+	printHelp();
+	elevator_trace_line();
+	slave_report_line();
+
+	if (rxOverrun)
+	{
+		rxOverrun = false;
+		lineTooLong = true; // Bytes are missing, the line cannot be trusted
+	}
+
+	for (uint8_t n = 0; (n < RX_PER_PASS) && rxbuf_pop(&rx, &c); n++)
+	{
+		if ((c == '\r') || (c == '\n'))
+		{
+			line[lineLen] = '\0';
+			if (lineTooLong)
+			{
+				printf_P(PSTR("Line dropped\n"));
+			}
+			else
+			{
+				runLine(line);
+			}
+			lineLen = 0;
+			lineTooLong = false;
+			return; // At most one command per pass
+		}
+		if ((c == '\b') || (c == 0x7F))
+		{
+			if (lineLen > 0)
+			{
+				lineLen--;
+			}
+		}
+		else if (lineLen < CONSOLE_LINE_SIZE - 1)
+		{
+			line[lineLen++] = c;
+		}
+		else
+		{
+			lineTooLong = true;
+		}
+	}
+}
+
+uint8_t console_verbosity(void)
+{
+	return verbosity;
+}
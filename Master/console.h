@@ -0,0 +1,40 @@
+/*
+ * console.h
+ *
+ * Created: 16.10.2026
+ *
+ * Line oriented command console on the debug UART. Received bytes are
+ * buffered by the RX interrupt, console_task() assembles and runs one line
+ * at a time, so a slow or chatty terminal never holds up the FSM. Type
+ * "help" for the command list.
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CONSOLE_RX_SIZE 32 // Power of two
+#define CONSOLE_LINE_SIZE 24
+
+// Verbosity of the status prints, faults are always printed
+#define CONSOLE_QUIET 0
+#define CONSOLE_INFO 1	// Trips, parking and call assignment
+#define CONSOLE_TRACE 2 // Every FSM transition as well
+
+#ifndef CONSOLE_DEFAULT_VERBOSITY
+#define CONSOLE_DEFAULT_VERBOSITY CONSOLE_INFO
+#endif
+
+// Enables the RX interrupt, the USART itself is set up by main.c
+void console_init(void);
+
+void console_task(void);
+
+uint8_t console_verbosity(void);
+
+// True if prints of this level are enabled
+#define CONSOLE_VERBOSE(level) (console_verbosity() >= (level))
+
+#endif // CONSOLE_H
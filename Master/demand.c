@@ -0,0 +1,137 @@
+/*
+ * demand.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "demand.h"
+#include "eeprom_map.h"
+#include "timer.h"
+#include "eventlog.h"
+#include <avr/eeprom.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define DEMAND_MAGIC 0xD701			  // Bump when the layout changes
+#define DEMAND_MAGIC_ADDR EEPROM_DEMAND_START
+#define DEMAND_TABLE_ADDR (EEPROM_DEMAND_START + 0x10)
+#define MINUTES_PER_DAY 1440
+#define MS_PER_MINUTE 60000UL
+
+// One byte per floor and slot. When a counter saturates the whole slot is
+// halved, so old habits fade and the ratios between floors are kept.
+static uint8_t counts[DEMAND_SLOTS][DEMAND_FLOORS];
+static uint8_t dirty = 0; // One bit per slot not yet written to EEPROM
+static uint16_t clockOffset = 0; // Minute of the day at timer_millis() == 0
+static uint8_t writeSlot = DEMAND_SLOTS; // Slot being written back, DEMAND_SLOTS = idle
+static uint8_t writeFloor = 0;			 // Next byte of it
+static bool flushing = false;			 // Writing back until no slot is dirty
+static uint32_t lastFlush = 0;
+
+void demand_init(void)
+{
+	if (eeprom_read_word(EEPROM_ADDR(DEMAND_MAGIC_ADDR)) == DEMAND_MAGIC)
+	{
+		eeprom_read_block(counts, EEPROM_ADDR(DEMAND_TABLE_ADDR), sizeof(counts));
+		dirty = 0;
+	}
+	else
+	{
+		memset(counts, 0, sizeof(counts)); // Blank or foreign EEPROM, start learning
+		eeprom_update_word(EEPROM_ADDR(DEMAND_MAGIC_ADDR), DEMAND_MAGIC);
+		dirty = 0xFF;
+	}
+}
+
+void demand_set_time(uint16_t minuteOfDay)
+{
+	uint16_t uptime = (timer_millis() / MS_PER_MINUTE) % MINUTES_PER_DAY;
+
+	clockOffset = (minuteOfDay % MINUTES_PER_DAY + MINUTES_PER_DAY - uptime) % MINUTES_PER_DAY;
+}
+
+uint8_t demand_slot(void)
+{
+	uint16_t minute = (clockOffset + timer_millis() / MS_PER_MINUTE) % MINUTES_PER_DAY;
+
+	return minute / DEMAND_SLOT_MINUTES;
+}
+
+void demand_record(uint8_t floor)
+{
+	uint8_t slot = demand_slot();
+	uint8_t *row = counts[slot];
+
+	if (floor >= DEMAND_FLOORS)
+	{
+		return;
+	}
+	if (row[floor] == 0xFF)
+	{
+		for (uint8_t i = 0; i < DEMAND_FLOORS; i++)
+		{
+			row[i] >>= 1;
+		}
+	}
+	row[floor]++;
+	dirty |= 1 << slot;
+}
+
+uint8_t demand_best_floor(uint8_t current)
+{
+	const uint8_t *row = counts[demand_slot()];
+	uint8_t best = current;
+	uint8_t bestCount = (current < DEMAND_FLOORS) ? row[current] : 0;
+
+	if (bestCount < DEMAND_MIN_COUNT)
+	{
+		bestCount = DEMAND_MIN_COUNT - 1;
+	}
+	for (uint8_t i = 0; i < DEMAND_FLOORS; i++)
+	{
+		if (row[i] > bestCount)
+		{
+			best = i;
+			bestCount = row[i];
+		}
+	}
+	return best;
+}
+
+// Every DEMAND_FLUSH_MS the slots that changed are written back, one byte
+// per call and only once the EEPROM is ready, so no pass waits for it.
+// eeprom_update_byte() skips the bytes that did not change.
+void demand_task(void)
+{
+	if (writeSlot == DEMAND_SLOTS)
+	{
+		if ((dirty == 0) || (!flushing && ((timer_millis() - lastFlush) < DEMAND_FLUSH_MS)))
+		{
+			return;
+		}
+		flushing = true;
+		for (writeSlot = 0; !(dirty & (1 << writeSlot)); writeSlot++)
+		{
+			;
+		}
+		dirty &= ~(1 << writeSlot); // A count arriving from now on writes the slot again
+		writeFloor = 0;
+	}
+
+	eventlog_suspend(); // Shares the EEPROM with the log interrupt
+	if (eeprom_is_ready()) // Previous byte done, about 3.4 ms each
+	{
+		eeprom_update_byte(EEPROM_ADDR(DEMAND_TABLE_ADDR + writeSlot * DEMAND_FLOORS + writeFloor),
+						   counts[writeSlot][writeFloor]);
+		if (++writeFloor == DEMAND_FLOORS)
+		{
+			writeSlot = DEMAND_SLOTS;
+			if (dirty == 0)
+			{
+				flushing = false;
+				lastFlush = timer_millis();
+			}
+		}
+	}
+	eventlog_resume();
+}
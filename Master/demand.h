@@ -0,0 +1,37 @@
+/*
+ * demand.h
+ *
+ * Created: 16.10.2026
+ *
+ * Learned call demand. Calls are counted per floor and per time slot of the
+ * day in a small histogram that is kept in EEPROM, so the idle car can be
+ * parked where the next call is most likely to come from.
+ */
+
+#ifndef DEMAND_H
+#define DEMAND_H
+
+#include <stdint.h>
+
+#define DEMAND_SLOTS 8			 // Time slots per day
+#define DEMAND_SLOT_MINUTES 180	 // 24 h / DEMAND_SLOTS
+#define DEMAND_FLOORS 32		 // Same as FLOOR_COUNT
+#define DEMAND_MIN_COUNT 2		 // Calls needed before a floor is worth parking at
+#define DEMAND_FLUSH_MS 60000	 // Changed slots go to EEPROM at most this often
+
+void demand_init(void);
+
+// Count a call from a passenger waiting at floor in the current time slot
+void demand_record(uint8_t floor);
+
+// Floor with the highest demand in the current time slot. Returns current
+// unless another floor has strictly more calls.
+uint8_t demand_best_floor(uint8_t current);
+
+// There is no RTC, the time of day counts from boot. Set it once it is known.
+void demand_set_time(uint16_t minuteOfDay);
+uint8_t demand_slot(void);
+
+void demand_task(void); // Every scheduler pass, writes one byte at most
+
+#endif // DEMAND_H
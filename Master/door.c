@@ -0,0 +1,129 @@
+/*
+ * door.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "door.h"
+#include "timer.h"
+#include "params.h"
+
+#define OBSTRUCTION_PIN(car) (PA1 + (car))
+
+void door_init_io(void)
+{
+	for (uint8_t car = 0; car < CAR_COUNT; car++)
+	{
+		DDRA &= ~(1 << OBSTRUCTION_PIN(car)); // Obstruction input (light curtain / safety edge)
+	}
+}
+
+void door_init(Door *door, uint8_t car)
+{
+	door->car = car;
+	door->phase = DOORS_CLOSED;
+	door->deadline = 0;
+	door->dwell = param(PARAM_DWELL_CAR);
+	door->obstructed = 0;
+}
+
+void door_open(Door *door, uint16_t dwell_ms)
+{
+	if (door->phase != DOORS_OPEN)
+	{
+		queueCommandToSlave(door->car, PROTO_DOOR_OPEN); // Open door LED
+	}
+	door->phase = DOORS_OPEN;
+	door->dwell = dwell_ms;
+	door->deadline = timer_millis() + dwell_ms;
+}
+
+void door_close_key(Door *door)
+{
+	uint32_t earliest = timer_millis() + param(PARAM_DWELL_MIN);
+
+	if ((door->phase == DOORS_OPEN) && ((int32_t)(door->deadline - earliest) > 0))
+	{
+		door->deadline = earliest;
+	}
+}
+
+void door_reopen(Door *door)
+{
+	if (door->phase != DOORS_CLOSED)
+	{
+		door_open(door, door->dwell); // A closing door goes back open, an open one gets a fresh dwell
+	}
+}
+
+// The Slave carried out the close command and reports its door output off
+static bool closed(const Door *door)
+{
+	const SlaveState *s = slave_state(door->car);
+
+	return slave_confirmed(door->car) && !(s->outputs & PROTO_OUT_DOOR);
+}
+
+DoorEvent door_step(Door *door, uint32_t now)
+{
+	if (door->phase == DOORS_CLOSED)
+	{
+		door->obstructed = 0;
+		return DOOR_EVT_NONE;
+	}
+
+	if (PINA & (1 << OBSTRUCTION_PIN(door->car)))
+	{
+		if (door->obstructed < DOOR_OBSTRUCTION_DEBOUNCE)
+		{
+			door->obstructed++;
+		}
+	}
+	else
+	{
+		door->obstructed = 0;
+	}
+
+	if (door->obstructed == DOOR_OBSTRUCTION_DEBOUNCE)
+	{
+		// Hold the door while something is in the way
+		bool wasClosing = (door->phase == DOORS_CLOSING);
+
+		if (wasClosing)
+		{
+			queueCommandToSlave(door->car, PROTO_DOOR_OPEN);
+		}
+		door->phase = DOORS_OPEN;
+		if ((int32_t)(door->deadline - (now + param(PARAM_OBSTRUCTION))) < 0)
+		{
+			door->deadline = now + param(PARAM_OBSTRUCTION);
+		}
+		return wasClosing ? DOOR_EVT_OPENED : DOOR_EVT_NONE;
+	}
+
+	if (door->phase == DOORS_CLOSING)
+	{
+		if (closed(door) || ((int32_t)(now - door->deadline) >= 0))
+		{
+			door->phase = DOORS_CLOSED;
+			return DOOR_EVT_CLOSED;
+		}
+		if (slave_last_status(door->car) == SLAVE_OK) // No point asking a Slave that does not answer
+		{
+			slave_poll(door->car); // Ask again, the answer is there by the next tick
+		}
+		return DOOR_EVT_NONE;
+	}
+
+	if ((int32_t)(now - door->deadline) < 0)
+	{
+		return DOOR_EVT_NONE;
+	}
+
+	// Dwell over
+	queueCommandToSlave(door->car, PROTO_DOOR_CLOSE); // Close door LED
+	door->phase = DOORS_CLOSING;
+	door->deadline = now + param(PARAM_DOOR_CLOSE); // Unless the Slave confirms earlier
+	slave_poll(door->car);
+	return DOOR_EVT_CLOSING;
+}
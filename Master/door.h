@@ -0,0 +1,71 @@
+/*
+ * door.h
+ *
+ * Created: 16.10.2026
+ *
+ * Door controller. The door stays open for a dwell that depends on why the
+ * car stopped, then closes. It counts as closed once the Slave's status
+ * block confirms its door output is off, or after PARAM_DOOR_CLOSE if the
+ * Slave does not answer. The close key shortens the
+ * dwell, the reopen key and the obstruction input (PA1 for car 0, PA2 for
+ * car 1 and so on, active high) send a closing door back open. door_step()
+ * is polled, it never waits.
+ */
+
+#ifndef DOOR_H
+#define DOOR_H
+
+#include <avr/io.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "slave_comm.h"
+
+#if CAR_COUNT > 7
+#error "Obstruction inputs PA1..PA7 allow at most 7 cars"
+#endif
+
+#define DOOR_TICK_MS 10				// door_step() period
+
+// Defaults of the door parameters, see params.h
+#define DOOR_DWELL_HALL_MS 5000		// Passengers walk in from the landing
+#define DOOR_DWELL_CAR_MS 3000		// Passengers step out of the car
+#define DOOR_DWELL_MIN_MS 1000		// Dwell left after the close key
+#define DOOR_OBSTRUCTION_MS 2000	// Dwell after the obstruction clears
+#define DOOR_CLOSE_MS 1500			// Time the door takes to close
+#define DOOR_OBSTRUCTION_DEBOUNCE 3 // door_step() ticks
+
+typedef enum
+{
+	DOORS_CLOSED,
+	DOORS_OPEN,
+	DOORS_CLOSING
+} DoorPhase;
+
+typedef enum
+{
+	DOOR_EVT_NONE,
+	DOOR_EVT_OPENED,  // Door was sent (back) open
+	DOOR_EVT_CLOSING, // Dwell over, door started closing
+	DOOR_EVT_CLOSED	  // Door fully closed
+} DoorEvent;
+
+typedef struct
+{
+	DoorPhase phase;
+	uint32_t deadline; // timer_millis() at which the dwell or the closing ends
+	uint16_t dwell;	   // Dwell used when the door is reopened
+	uint8_t obstructed; // Debounce counter of the obstruction input
+	uint8_t car;
+} Door;
+
+void door_init_io(void);
+void door_init(Door *door, uint8_t car);
+
+// Open the door (or keep it open) for dwell_ms
+void door_open(Door *door, uint16_t dwell_ms);
+void door_close_key(Door *door);
+void door_reopen(Door *door);
+
+DoorEvent door_step(Door *door, uint32_t now);
+
+#endif // DOOR_H
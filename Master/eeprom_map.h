@@ -0,0 +1,25 @@
+/*
+ * eeprom_map.h
+ *
+ * Created: 16.10.2026
+ *
+ * Layout of the ATmega2560 EEPROM (4 KiB). Every module that keeps data in
+ * EEPROM takes its address from here so the regions cannot overlap.
+ */
+
+#ifndef EEPROM_MAP_H
+#define EEPROM_MAP_H
+
+#include <stdint.h>
+
+#define EEPROM_ADDR(a) ((void *)(uintptr_t)(a))
+
+#define EEPROM_CHECKPOINT_START 0x000 // 0x000-0x0FF controller checkpoint ring
+#define EEPROM_CHECKPOINT_SIZE 0x100
+#define EEPROM_PARAMS_START 0x100	  // 0x100-0x17F tunable parameters
+#define EEPROM_DEMAND_START 0x180	  // 0x180-0x2BF call demand histogram
+#define EEPROM_LOG_START 0x2C0		  // 0x2C0-0xFFF event log
+#define EEPROM_LOG_SIZE 0xD40
+#define EEPROM_END 0x1000
+
+#endif // EEPROM_MAP_H
@@ -0,0 +1,1013 @@
+/*
+ * elevator.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "elevator.h"
+#include "events.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "emergency.h"
+#include "slave_comm.h"
+#include "lcd_handler.h"
+#include "calls.h"
+#include "motion.h"
+#include "door.h"
+#include "demand.h"
+#include "traffic.h"
+#include "checkpoint.h"
+#include "eventlog.h"
+#include "stats.h"
+#include "console.h"
+#include "params.h"
+#include "prof.h"
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <string.h>
+
+// Set to 0 to leave out the transition prints. They only go out at console
+// verbosity 2 and cost ~40 ms per line at 9600 baud.
+#ifndef FSM_TRACE_UART
+#define FSM_TRACE_UART 1
+#endif
+
+#define FSM_TRACE_MASK (FSM_TRACE_SIZE - 1)
+#define ETA_REFRESH_MS 250 // LCD update period of the ETA while moving
+#define SERVE_TIME_NONE 0xFFFFFFFFUL // Car cannot take calls
+#define DOOR_CYCLED 1 // EVT_DOOR_TIMEOUT arg: the door opened and closed, 0 for a parking arrival
+// Rough cost of an intermediate stop on top of the travel time
+#define STOP_COST_MS (param(PARAM_DWELL_CAR) + param(PARAM_DOOR_CLOSE) + motionProfile.startDelay + motionProfile.levelTime)
+
+typedef enum
+{
+	ACT_IGNORE, // Event is not handled in this state, no transition
+	ACT_NONE,	// Transition without side effects
+	ACT_REGISTER_CALL,
+	ACT_SELECT_FLOOR,
+	ACT_DEPART,
+	ACT_PASS_FLOOR,
+	ACT_ARRIVE,
+	ACT_DOOR_DELAY,
+	ACT_OPEN_DOOR,
+	ACT_CLOSE_DOOR,
+	ACT_DOOR_CLOSE_KEY,
+	ACT_DOOR_REOPEN_KEY,
+	ACT_REOPEN,
+	ACT_ABORT_DEPARTURE,
+	ACT_PARK,
+	ACT_START_PARKING,
+	ACT_EMERGENCY,
+	ACT_EMERGENCY_ACK,
+	ACT_RESUME,
+	ACT_FAULT,
+	ACT_COUNT
+} ActionId;
+
+typedef struct
+{
+	uint8_t action; // ActionId
+	uint8_t next;	// ElevatorState
+} Transition;
+
+typedef struct
+{
+	uint16_t time; // Low 16 bits of timer_millis()
+	uint8_t car;
+	uint8_t state;
+	uint8_t event;
+	uint8_t next;
+} TraceEntry;
+
+// Emergency and faults are accepted in every state that does not list them,
+// and so are new calls, which only update the call registry
+#define COMMON_TRANSITIONS                             \
+	[EVT_EMERGENCY] = {ACT_EMERGENCY, EMERGENCY},      \
+	[EVT_FAULT] = {ACT_FAULT, FAULT}
+#define ACCEPT_CALLS(s) [EVT_KEY_CONFIRMED] = {ACT_REGISTER_CALL, s}
+
+static const Transition transitions[STATE_COUNT][EVT_COUNT] PROGMEM = {
+	[IDLE] = {
+		ACCEPT_CALLS(IDLE),
+		[EVT_DISPATCH] = {ACT_SELECT_FLOOR, FLOOR_SELECTED},
+		[EVT_DOOR_REOPEN] = {ACT_REOPEN, DOOR_OPEN},
+		[EVT_TIMEOUT] = {ACT_PARK, IDLE}, // Idle long enough, posts EVT_PARK if the car should move
+		[EVT_PARK] = {ACT_START_PARKING, MOVING},
+		COMMON_TRANSITIONS,
+	},
+	[FLOOR_SELECTED] = {
+		ACCEPT_CALLS(FLOOR_SELECTED),
+		[EVT_TIMEOUT] = {ACT_DEPART, MOVING},			   // Start delay over
+		[EVT_FLOOR_REACHED] = {ACT_DOOR_DELAY, DOOR_OPEN}, // Was already on the floor
+		[EVT_DOOR_REOPEN] = {ACT_ABORT_DEPARTURE, DOOR_OPEN}, // Car has not moved yet
+		COMMON_TRANSITIONS,
+	},
+	[MOVING] = {
+		ACCEPT_CALLS(MOVING), // May retarget the car to a closer floor
+		[EVT_FLOOR_PASSED] = {ACT_PASS_FLOOR, MOVING},
+		[EVT_FLOOR_REACHED] = {ACT_ARRIVE, DOOR_OPEN},
+		COMMON_TRANSITIONS,
+	},
+	[FAULT] = {
+		[EVT_KEY_PRESSED] = {ACT_RESUME, IDLE}, // Any key clears the fault
+		[EVT_EMERGENCY] = {ACT_EMERGENCY, EMERGENCY},
+	},
+	[DOOR_OPEN] = {
+		ACCEPT_CALLS(DOOR_OPEN),
+		[EVT_TIMEOUT] = {ACT_OPEN_DOOR, DOOR_OPEN},
+		[EVT_DOOR_TIMEOUT] = {ACT_CLOSE_DOOR, IDLE}, // Posts EVT_DISPATCH if calls are left
+		[EVT_DOOR_CLOSE] = {ACT_DOOR_CLOSE_KEY, DOOR_OPEN},
+		[EVT_DOOR_REOPEN] = {ACT_DOOR_REOPEN_KEY, DOOR_OPEN},
+		COMMON_TRANSITIONS,
+	},
+	[EMERGENCY] = {
+		[EVT_KEY_PRESSED] = {ACT_EMERGENCY_ACK, RECOVERING},
+	},
+	[RECOVERING] = {
+		ACCEPT_CALLS(RECOVERING),
+		[EVT_TIMEOUT] = {ACT_RESUME, IDLE},
+		[EVT_SLAVE_DONE] = {ACT_RESUME, IDLE}, // Melody over before PARAM_RECOVER
+		COMMON_TRANSITIONS,
+	},
+};
+
+static const char stateIdle[] PROGMEM = "IDLE";
+static const char stateFloorSelected[] PROGMEM = "FLOOR_SELECTED";
+static const char stateMoving[] PROGMEM = "MOVING";
+static const char stateFault[] PROGMEM = "FAULT";
+static const char stateDoorOpen[] PROGMEM = "DOOR_OPEN";
+static const char stateEmergency[] PROGMEM = "EMERGENCY";
+static const char stateRecovering[] PROGMEM = "RECOVERING";
+
+static PGM_P const stateNames[STATE_COUNT] PROGMEM = {
+	stateIdle, stateFloorSelected, stateMoving, stateFault, stateDoorOpen, stateEmergency, stateRecovering};
+
+// Everything the FSM knows about one car
+typedef struct
+{
+	uint8_t id;		 // Car number, also selects the Slave address
+	ElevatorState state;
+	sched_timer_t waitTimer;
+	uint8_t waitEvent; // Posted when waitTimer expires
+
+	// Current floor and the stop the car is heading for
+	uint8_t currentFloor;
+	uint8_t selectedFloor;
+	Direction travelDir;
+	CallRegistry calls;
+	Motion motion;
+	Door door;
+	bool hallStop;			 // The current stop serves a hall call, use the longer dwell
+	bool parking;			 // Empty trip to the parking floor
+	uint32_t tripStart;		 // timer_millis() when the trip was decided
+	uint32_t tripEstimate;	 // Estimated trip time in ms
+	uint32_t lastEtaRefresh;
+	char doorOpen[15];		 // Door status line
+	bool resumed;			 // Restored from the checkpoint, see elevator_resume_report()
+} Car;
+
+static Car cars[CAR_COUNT];
+static uint8_t focusCar = 0; // Car shown on the LCD and taking the keypad's car calls
+static uint32_t lastMotionTick = 0;
+
+static TraceEntry trace[FSM_TRACE_SIZE];
+static uint8_t traceHead = 0;
+static uint8_t traceCount = 0;
+static uint8_t traceDumpIndex = 0; // Next entry elevator_trace_line() prints
+static uint8_t traceDumpLeft = 0;
+
+static void displayFloorMessage(const Car *c, const char *format, int floorNumber, const char *doorOpen) //Display floor and status
+{
+    char message[50]; //Define a string
+
+    if (c->id != focusCar) // One LCD for the group
+    {
+        return;
+    }
+    sprintf(message, format, floorNumber); //Format a string with sprintf
+    write_to_lcd(message, doorOpen); //Writing floor and status on screen
+}
+
+static void waitDone(uint8_t car)
+{
+	cars[car].waitTimer = SCHED_TIMER_NONE;
+	event_post_car(car, cars[car].waitEvent, 0); // Timer expired, let the FSM continue
+}
+
+// Post event after ms milliseconds, replacing any wait already running
+static void fsmWait(Car *c, uint16_t ms, EventType event)
+{
+	sched_timer_cancel(c->waitTimer);
+	c->waitEvent = event;
+	c->waitTimer = sched_timer_start(ms, 0, waitDone, c->id);
+	if (c->waitTimer == SCHED_TIMER_NONE)
+	{
+		event_post_car(c->id, EVT_FAULT, FAULT_NO_TIMER); // No free timer, do not hang the FSM
+	}
+}
+
+static void cancelWait(Car *c)
+{
+	sched_timer_cancel(c->waitTimer);
+	c->waitTimer = SCHED_TIMER_NONE;
+}
+
+// Clear the calls served at the current floor, counting the hall calls as
+// picked up
+static Direction serveCalls(Car *c, Direction dir)
+{
+	uint8_t up = CALL_HALL_UP | c->currentFloor;
+	uint8_t down = CALL_HALL_DOWN | c->currentFloor;
+	bool upWaiting = calls_has(&c->calls, up);
+	bool downWaiting = calls_has(&c->calls, down);
+
+	dir = calls_serve(&c->calls, c->currentFloor, dir);
+	if (upWaiting && !calls_has(&c->calls, up))
+	{
+		stats_pickup(up);
+	}
+	if (downWaiting && !calls_has(&c->calls, down))
+	{
+		stats_pickup(down);
+	}
+	return dir;
+}
+
+// Duration in 0.1 s for the event log, saturating at 25.5 s
+static uint8_t tenths(uint32_t ms)
+{
+	return (ms < 25500) ? (uint8_t)(ms / 100) : 255;
+}
+
+// Line 1 shows the landing being passed, line 2 the destination and ETA
+static void showMoving(Car *c)
+{
+	char eta[17];
+	uint32_t ms = motion_eta_ms(&c->motion);
+
+	snprintf(eta, sizeof(eta), "To %d ETA %lu.%lus", c->selectedFloor, ms / 1000, (ms % 1000) / 100);
+	displayFloorMessage(c, "Current floor %d", c->currentFloor, eta); //Display floor number of passed floors
+	c->lastEtaRefresh = timer_millis();
+}
+
+// Move the target of a travelling car to stop, if it can still brake for it
+static void moveTarget(Car *c, uint8_t stop)
+{
+	if ((stop != c->selectedFloor) && motion_retarget(&c->motion, stop))
+	{
+		if (CONSOLE_VERBOSE(CONSOLE_INFO))
+		{
+			printf("Car %d retarget %d -> %d\n", c->id, c->selectedFloor, stop);
+		}
+		c->selectedFloor = stop;
+		showMoving(c);
+	}
+}
+
+// Look for a stop closer than the current target that the car can still
+// brake for, and move the target there
+static void retarget(Car *c)
+{
+	uint8_t from = motion_stop_floor(&c->motion); // Nearest landing the car can stop at
+	Direction dir = c->travelDir;
+	uint8_t stop;
+
+	if (calls_stop_here(&c->calls, from, dir))
+	{
+		stop = from;
+	}
+	else if (!calls_next_stop(&c->calls, from, &dir, &stop) || (dir != c->travelDir))
+	{
+		return; // Nothing new ahead of the car
+	}
+	moveTarget(c, stop);
+}
+
+static void registerCall(Car *c, uint8_t call)
+{
+	if (!calls_add(&c->calls, call))
+	{
+		return;
+	}
+	if (CONSOLE_VERBOSE(CONSOLE_INFO))
+	{
+		printf("Car %d floornumber", c->id); // Debuggin test prints
+		printf("%d\n", call & CALL_FLOOR_MASK); //Display selected floor
+	}
+
+	if (c->state == IDLE)
+	{
+		event_post_car(c->id, EVT_DISPATCH, 0);
+	}
+	else if (c->state == MOVING)
+	{
+		retarget(c);
+		if (c->parking && !calls_stop_here(&c->calls, c->selectedFloor, DIR_NONE))
+		{
+			moveTarget(c, motion_stop_floor(&c->motion)); // Call is not on the way, stop parking at the next landing
+		}
+	}
+	else if ((c->state == DOOR_OPEN) && calls_stop_here(&c->calls, c->currentFloor, c->travelDir))
+	{
+		// Car is already here, serve the call by holding the door
+		bool hall = calls_hall_at(&c->calls, c->currentFloor);
+
+		c->travelDir = serveCalls(c, c->travelDir);
+		door_open(&c->door, param(hall ? PARAM_DWELL_HALL : PARAM_DWELL_CAR));
+		strcpy(c->doorOpen, "Door open");
+		displayFloorMessage(c, "Arrived on %d", c->currentFloor, c->doorOpen);
+	}
+}
+
+// Pick the next stop with LOOK and start the trip towards it
+static void selectFloor(Car *c, uint8_t arg)
+{
+	char eta[17];
+
+	if (calls_stop_here(&c->calls, c->currentFloor, DIR_NONE)) //If a call is on the current floor
+	{
+		c->selectedFloor = c->currentFloor;
+		queueCommandArgToSlave(c->id, PROTO_BLINK, 3); // Blink movement LED = FAULT
+		displayFloorMessage(c, "Already on %d", c->currentFloor, c->doorOpen); //Display message
+		fsmWait(c, param(PARAM_ALREADY_ON), EVT_FLOOR_REACHED); // Leave the message up for a while
+	}
+	else if (calls_next_stop(&c->calls, c->currentFloor, &c->travelDir, &c->selectedFloor)) //Move the elevator to selected floor
+	{
+		uint8_t floors = (c->selectedFloor > c->currentFloor) ? (c->selectedFloor - c->currentFloor) : (c->currentFloor - c->selectedFloor);
+
+		c->tripStart = timer_millis();
+		c->tripEstimate = motion_trip_time_ms(floors);
+		if (CONSOLE_VERBOSE(CONSOLE_INFO))
+		{
+			printf("Car %d trip %d -> %d, estimate %lu ms\n", c->id, c->currentFloor, c->selectedFloor, c->tripEstimate);
+		}
+		eventlog_write(LOG_TRIP_START, c->id, c->currentFloor, c->selectedFloor);
+
+		queueCommandToSlave(c->id, PROTO_MOVE_ON); // Turn on movement LED
+		snprintf(eta, sizeof(eta), "ETA %lu.%lus", c->tripEstimate / 1000, (c->tripEstimate % 1000) / 100);
+		displayFloorMessage(c, "Moving to %d", c->selectedFloor, eta); //Display message of moving
+		fsmWait(c, motionProfile.startDelay, EVT_TIMEOUT); // Brake lift before the motor starts
+	}
+	else
+	{
+		event_post_car(c->id, EVT_FAULT, FAULT_NO_CALL); // DISPATCH without a call
+	}
+}
+
+// Start delay over, the motion model takes the car to the target
+static void depart(Car *c, uint8_t arg)
+{
+	// Calls may have changed during the start delay
+	if (calls_stop_here(&c->calls, c->currentFloor, c->travelDir) ||
+		!calls_next_stop(&c->calls, c->currentFloor, &c->travelDir, &c->selectedFloor) ||
+		!motion_start(&c->motion, c->selectedFloor))
+	{
+		event_post_car(c->id, EVT_FLOOR_REACHED, c->currentFloor);
+		return;
+	}
+	showMoving(c);
+}
+
+// The car passed (or is braking into) another landing
+static void passFloor(Car *c, uint8_t floor)
+{
+	c->currentFloor = floor;
+	stats_floor();
+	retarget(c);
+	showMoving(c);
+}
+
+static void arrive(Car *c, uint8_t arg)
+{
+	c->currentFloor = motion_floor(&c->motion);
+	queueCommandToSlave(c->id, PROTO_MOVE_OFF); // Turn off movement LED
+	if (c->parking && !calls_stop_here(&c->calls, c->currentFloor, DIR_NONE))
+	{
+		c->parking = false;
+		if (CONSOLE_VERBOSE(CONSOLE_INFO))
+		{
+			printf("Car %d parked on %d\n", c->id, c->currentFloor);
+		}
+		eventlog_write(LOG_TRIP_END, c->id, c->currentFloor, tenths(timer_millis() - c->tripStart));
+		event_post_car(c->id, EVT_DOOR_TIMEOUT, 0); // Nobody to let in or out, keep the door shut
+		return;
+	}
+	c->parking = false;
+	eventlog_write(LOG_TRIP_END, c->id, c->currentFloor, tenths(timer_millis() - c->tripStart));
+	stats_trip();
+	c->hallStop = calls_hall_at(&c->calls, c->currentFloor);
+	c->travelDir = serveCalls(c, c->travelDir);
+	if (CONSOLE_VERBOSE(CONSOLE_INFO))
+	{
+		printf("Car %d arrived on %d after %lu ms (estimate %lu ms)\n", c->id, c->currentFloor, timer_millis() - c->tripStart,
+			   c->tripEstimate);
+	}
+	displayFloorMessage(c, "Arrived on %d", c->currentFloor, c->doorOpen); // Display message of arrival
+	fsmWait(c, 100, EVT_TIMEOUT); // Levelling is done, 0,1 second door delay
+}
+
+static void doorDelay(Car *c, uint8_t arg)
+{
+	c->hallStop = calls_hall_at(&c->calls, c->currentFloor);
+	c->travelDir = serveCalls(c, DIR_NONE);
+	fsmWait(c, 100, EVT_TIMEOUT); // wait for 0,1 seconds
+}
+
+static void openDoor(Car *c, uint8_t arg)
+{
+	focusCar = c->id; // Passengers boarding this car enter their car calls next
+	strcpy(c->doorOpen, "Door open"); // Copy door opening message to string
+	displayFloorMessage(c, "Arrived on %d", c->currentFloor, c->doorOpen); // DIsplay message of arrival
+	door_open(&c->door, param(c->hallStop ? PARAM_DWELL_HALL : PARAM_DWELL_CAR)); // Door task posts EVT_DOOR_TIMEOUT once closed
+}
+
+static void doorCloseKey(Car *c, uint8_t arg)
+{
+	door_close_key(&c->door);
+}
+
+static void doorReopenKey(Car *c, uint8_t arg)
+{
+	door_reopen(&c->door);
+	strcpy(c->doorOpen, "Door open");
+	displayFloorMessage(c, "Arrived on %d", c->currentFloor, c->doorOpen);
+}
+
+// Reopen key on a car that is standing at the landing with the door shut
+static void reopen(Car *c, uint8_t arg)
+{
+	cancelWait(c); // Parking delay or start delay
+	c->hallStop = false;
+	openDoor(c, arg);
+}
+
+// Reopen key during the start delay, the trip starts over once the door closes
+static void abortDeparture(Car *c, uint8_t arg)
+{
+	queueCommandToSlave(c->id, PROTO_MOVE_OFF); // Turn off movement LED
+	reopen(c, arg);
+}
+
+// Idle long enough, move the empty car to where the next call is most likely
+// to come from according to the traffic policy
+static void park(Car *c, uint8_t arg)
+{
+	uint8_t floor;
+
+	switch (traffic_policy())
+	{
+	case POLICY_LOBBY_RETURN:
+		floor = TRAFFIC_LOBBY_FLOOR;
+		break;
+	case POLICY_ZONED:
+		floor = traffic_zone_floor();
+		break;
+	default:
+		floor = demand_best_floor(c->currentFloor);
+		break;
+	}
+
+	for (uint8_t i = 0; i < CAR_COUNT; i++)
+	{
+		const Car *o = &cars[i];
+
+		// One car per parking floor
+		if ((o != c) && ((o->parking && (o->selectedFloor == floor)) || ((o->state == IDLE) && (o->currentFloor == floor))))
+		{
+			return;
+		}
+	}
+
+	if (floor != c->currentFloor)
+	{
+		event_post_car(c->id, EVT_PARK, floor);
+	}
+}
+
+static void startParking(Car *c, uint8_t floor)
+{
+	c->parking = true;
+	if (calls_pending(&c->calls) || !motion_start(&c->motion, floor)) // A call came in meanwhile
+	{
+		event_post_car(c->id, EVT_FLOOR_REACHED, c->currentFloor); // Back to IDLE through arrive()
+		return;
+	}
+	if (CONSOLE_VERBOSE(CONSOLE_INFO))
+	{
+		printf("Car %d parking %d -> %d (slot %d)\n", c->id, c->currentFloor, floor, demand_slot());
+	}
+	eventlog_write(LOG_TRIP_START, c->id, c->currentFloor, floor);
+	c->selectedFloor = floor;
+	c->travelDir = (floor > c->currentFloor) ? DIR_UP : DIR_DOWN;
+	c->tripStart = timer_millis();
+	c->tripEstimate = motion_eta_ms(&c->motion);
+	queueCommandToSlave(c->id, PROTO_MOVE_ON); // Turn on movement LED
+	showMoving(c);
+}
+
+// Back to IDLE, leave again at once if calls are waiting
+static void resume(Car *c, uint8_t arg)
+{
+	cancelWait(c); // The Slave may have finished before the hold ran out
+	displayFloorMessage(c, "Floor %d", c->currentFloor, c->doorOpen); //Display floor
+	if (calls_pending(&c->calls))
+	{
+		event_post_car(c->id, EVT_DISPATCH, 0);
+	}
+	else
+	{
+		c->travelDir = DIR_NONE;
+		fsmWait(c, param((traffic_policy() == POLICY_LOOK) ? PARAM_PARK_DELAY : PARAM_PARK_PEAK), EVT_TIMEOUT);
+	}
+}
+
+static void closeDoor(Car *c, uint8_t arg)
+{
+	if (arg == DOOR_CYCLED) // A parked car arrives with the door shut
+	{
+		eventlog_write(LOG_DOOR_CYCLE, c->id, c->currentFloor, 0);
+		stats_door_cycle();
+	}
+	strcpy(c->doorOpen, "Door closed"); //Copy door closing message to string
+	resume(c, arg);
+}
+
+static void handleEmergency(Car *c, uint8_t arg) //Create a emergency handling state function
+{
+	cancelWait(c); // Emergency preempts whatever the FSM was waiting for
+	event_flush(); // Pending steps of the interrupted sequence are void
+	calls_init(&c->calls); // Passengers have to call again once the car is back in service
+	c->travelDir = DIR_NONE;
+	c->parking = false;
+	c->currentFloor = motion_floor(&c->motion);
+	motion_init(&c->motion, c->currentFloor); // Car stops at the nearest landing
+	door_init(&c->door, c->id); // Slave emergency sequence handles the door LED
+	eventlog_write(LOG_EMERGENCY, c->id, c->currentFloor, 0);
+
+	printf("Emergency latency %lu us (max %lu us)\n", emergency_last_latency_us(), emergency_max_latency_us());
+	displayFloorMessage(c, "EMERGENCY %d", c->currentFloor, c->doorOpen); //Show emergency message
+	queueCommandArgToSlave(c->id, PROTO_BLINK, 3); // Blink movement LED = FAULT
+}
+
+static void acknowledgeEmergency(Car *c, uint8_t arg)
+{
+	strcpy(c->doorOpen, "Door open"); //Open door
+	displayFloorMessage(c, "EMERGENCY %d", c->currentFloor, c->doorOpen); //Display message of emergency
+	queueCommandArgToSlave(c->id, PROTO_EMERGENCY, 6); // Play buzzer melody
+	strcpy(c->doorOpen, "Door closed"); //Close door
+	fsmWait(c, param(PARAM_RECOVER), EVT_TIMEOUT); // Hold before taking calls again, unless the Slave reports done first
+}
+
+static void handleFault(Car *c, uint8_t code)
+{
+	cancelWait(c);
+	c->parking = false;
+	c->currentFloor = motion_floor(&c->motion);
+	motion_init(&c->motion, c->currentFloor);
+	if (c->door.phase != DOORS_CLOSED)
+	{
+		queueCommandToSlave(c->id, PROTO_DOOR_CLOSE); // Close door LED
+		strcpy(c->doorOpen, "Door closed");
+		door_init(&c->door, c->id);
+	}
+
+	printf("Car %d FAULT %d\n", c->id, code);
+	eventlog_write(LOG_FAULT, c->id, code, 0);
+	focusCar = c->id; // Show the fault
+	displayFloorMessage(c, "FAULT %d", code, "Press any key");
+	queueCommandArgToSlave(c->id, PROTO_BLINK, 3); // Blink movement LED = FAULT
+}
+
+static void (*const actions[ACT_COUNT])(Car *c, uint8_t arg) PROGMEM = {
+	[ACT_IGNORE] = NULL,
+	[ACT_NONE] = NULL,
+	[ACT_REGISTER_CALL] = registerCall,
+	[ACT_SELECT_FLOOR] = selectFloor,
+	[ACT_DEPART] = depart,
+	[ACT_PASS_FLOOR] = passFloor,
+	[ACT_ARRIVE] = arrive,
+	[ACT_DOOR_DELAY] = doorDelay,
+	[ACT_OPEN_DOOR] = openDoor,
+	[ACT_CLOSE_DOOR] = closeDoor,
+	[ACT_DOOR_CLOSE_KEY] = doorCloseKey,
+	[ACT_DOOR_REOPEN_KEY] = doorReopenKey,
+	[ACT_REOPEN] = reopen,
+	[ACT_ABORT_DEPARTURE] = abortDeparture,
+	[ACT_PARK] = park,
+	[ACT_START_PARKING] = startParking,
+	[ACT_EMERGENCY] = handleEmergency,
+	[ACT_EMERGENCY_ACK] = acknowledgeEmergency,
+	[ACT_RESUME] = resume,
+	[ACT_FAULT] = handleFault,
+};
+
+// Report the state a reset has to come back to, written only if it changed.
+// A moving car only reports a change of its calls, the floors it passes
+// would wear out the EEPROM (see checkpoint.h).
+static void saveCheckpoint(const Car *c)
+{
+	CarCheckpoint cp;
+
+	if ((c->state == MOVING) && !checkpoint_calls_changed(c->id, &c->calls))
+	{
+		return;
+	}
+
+	cp.floor = c->currentFloor;
+	cp.doorOpen = (c->door.phase != DOORS_CLOSED);
+	cp.calls = c->calls;
+	checkpoint_update(c->id, &cp);
+}
+
+static void dispatch(Car *c, uint8_t event, uint8_t arg)
+{
+	Transition t;
+	void (*action)(Car *, uint8_t);
+
+	memcpy_P(&t, &transitions[c->state][event], sizeof(t));
+	if (t.action == ACT_IGNORE)
+	{
+		return;
+	}
+	PROF_ENTER(PROF_FSM_STEP);
+
+	trace[traceHead].time = (uint16_t)timer_millis();
+	trace[traceHead].car = c->id;
+	trace[traceHead].state = c->state;
+	trace[traceHead].event = event;
+	trace[traceHead].next = t.next;
+	traceHead = (traceHead + 1) & FSM_TRACE_MASK;
+	if (traceCount < FSM_TRACE_SIZE)
+	{
+		traceCount++;
+	}
+
+#if FSM_TRACE_UART
+	if (CONSOLE_VERBOSE(CONSOLE_TRACE))
+	{
+		printf_P(PSTR("FSM %u %S -%u-> %S\n"), c->id, (PGM_P)pgm_read_word(&stateNames[c->state]), event,
+				 (PGM_P)pgm_read_word(&stateNames[t.next]));
+	}
+#endif
+
+	stats_state(c->id, c->state);
+	c->state = t.next;
+	action = (void (*)(Car *, uint8_t))pgm_read_word(&actions[t.action]);
+	if (action != NULL)
+	{
+		action(c, arg);
+	}
+	saveCheckpoint(c);
+	PROF_EXIT(PROF_FSM_STEP);
+}
+
+static void dispatchAll(uint8_t event, uint8_t arg)
+{
+	for (uint8_t i = 0; i < CAR_COUNT; i++)
+	{
+		dispatch(&cars[i], event, arg);
+	}
+}
+
+// Car that takes a new call: car calls belong to the car the passenger is
+// in, hall calls go to the car that can be there first
+static uint8_t assignCall(uint8_t call)
+{
+	uint8_t best = focusCar;
+	uint32_t bestTime = SERVE_TIME_NONE;
+
+	if ((call & CALL_TYPE_MASK) == CALL_CAR)
+	{
+		return focusCar;
+	}
+
+	for (uint8_t i = 0; i < CAR_COUNT; i++)
+	{
+		uint32_t time;
+
+		if (calls_has(&cars[i].calls, call))
+		{
+			return i; // Already assigned
+		}
+		time = elevator_serve_time(i, call);
+		if (time < bestTime)
+		{
+			best = i;
+			bestTime = time;
+		}
+	}
+	if (CONSOLE_VERBOSE(CONSOLE_INFO))
+	{
+		printf("Hall call %d to car %d, %lu ms\n", call & CALL_FLOOR_MASK, best, bestTime);
+	}
+	return best;
+}
+
+// Events from the keypad and the emergency input are for the whole group
+static void groupEvent(uint8_t event, uint8_t arg)
+{
+	uint8_t car;
+
+	switch (event)
+	{
+	case EVT_KEY_CONFIRMED:
+		car = assignCall(arg);
+		if (!calls_has(&cars[car].calls, arg))
+		{
+			demand_record((arg & CALL_TYPE_MASK) ? (arg & CALL_FLOOR_MASK) : cars[car].currentFloor); // Where the passenger waits
+			traffic_record_call(arg, cars[car].currentFloor);
+			stats_call(arg);
+		}
+		dispatch(&cars[car], event, arg);
+		break;
+	case EVT_DOOR_CLOSE:
+	case EVT_DOOR_REOPEN:
+		dispatch(&cars[focusCar], event, arg);
+		break;
+	default:
+		dispatchAll(event, arg); // Key presses clear faults and acknowledge emergencies in every car
+		break;
+	}
+}
+
+// Restores the cars from the EEPROM checkpoint if there is one, so a reset
+// does not need a homing trip
+void elevator_init(void)
+{
+	CarCheckpoint saved[CAR_COUNT];
+	bool restored = checkpoint_load(saved);
+
+	door_init_io();
+	focusCar = 0;
+	for (uint8_t i = 0; i < CAR_COUNT; i++)
+	{
+		Car *c = &cars[i];
+
+		c->id = i;
+		c->state = IDLE;
+		c->waitTimer = SCHED_TIMER_NONE;
+		c->currentFloor = 1;
+		c->selectedFloor = 1;
+		c->travelDir = DIR_NONE;
+		c->hallStop = false;
+		c->parking = false;
+		c->resumed = false;
+		strcpy(c->doorOpen, "Door closed");
+		calls_init(&c->calls);
+		motion_init(&c->motion, c->currentFloor);
+		door_init(&c->door, i);
+
+		if (restored && (saved[i].floor < FLOOR_COUNT))
+		{
+			c->currentFloor = saved[i].floor;
+			c->selectedFloor = c->currentFloor;
+			c->calls = saved[i].calls;
+			motion_init(&c->motion, c->currentFloor);
+			c->resumed = true; // Printed after the boot is timed
+		}
+
+		if (restored && saved[i].doorOpen)
+		{
+			c->state = DOOR_OPEN; // Passengers may be in the doorway, open again
+			openDoor(c, 0);
+		}
+		else
+		{
+			resume(c, 0);
+		}
+		saveCheckpoint(c);
+	}
+}
+
+// Drains the event queue. Runs on every scheduler pass and returns at once,
+// delays are scheduler timers that post an event when they expire.
+void elevator_task(void)
+{
+	Event event;
+
+	if (emergency_pending()) // Checked before anything else, in every state
+	{
+		emergency_acknowledge(); // Stops the latency measurement
+		stats_emergency();
+		dispatchAll(EVT_EMERGENCY, 0);
+	}
+
+	if (event_overflowed())
+	{
+		dispatchAll(EVT_FAULT, FAULT_EVENT_OVERFLOW);
+	}
+
+	while (event_get(&event))
+	{
+		if (event.car == EVENT_GROUP)
+		{
+			groupEvent(event.type, event.arg);
+		}
+		else if (event.car < CAR_COUNT)
+		{
+			dispatch(&cars[event.car], event.type, event.arg);
+		}
+	}
+
+	for (uint8_t i = 0; i < CAR_COUNT; i++) // Landing indicators, only changes go out
+	{
+		Direction dir = cars[i].travelDir;
+
+		slave_position(i, cars[i].currentFloor,
+					   (dir == DIR_UP) ? PROTO_DIR_UP : ((dir == DIR_DOWN) ? PROTO_DIR_DOWN : PROTO_DIR_NONE));
+	}
+}
+
+// Runs the motion model of every travelling car and turns landings passed
+// and the final levelling into events for the FSM
+void elevator_motion_task(void)
+{
+	uint32_t now = timer_millis();
+	uint16_t dt = (uint16_t)(now - lastMotionTick);
+
+	lastMotionTick = now;
+	for (uint8_t i = 0; i < CAR_COUNT; i++)
+	{
+		Car *c = &cars[i];
+		uint8_t floor;
+
+		if ((c->state != MOVING) || !motion_moving(&c->motion))
+		{
+			continue;
+		}
+
+		if (motion_step(&c->motion, dt))
+		{
+			event_post_car(i, EVT_FLOOR_REACHED, motion_floor(&c->motion));
+			continue;
+		}
+
+		floor = motion_floor(&c->motion);
+		if (floor != c->currentFloor)
+		{
+			event_post_car(i, EVT_FLOOR_PASSED, floor);
+		}
+		else if ((now - c->lastEtaRefresh) >= ETA_REFRESH_MS)
+		{
+			showMoving(c);
+		}
+	}
+}
+
+// Runs the door controllers and reports their progress to the FSM
+void elevator_door_task(void)
+{
+	uint32_t now = timer_millis();
+
+	for (uint8_t i = 0; i < CAR_COUNT; i++)
+	{
+		Car *c = &cars[i];
+
+		switch (door_step(&c->door, now))
+		{
+		case DOOR_EVT_OPENED:
+			strcpy(c->doorOpen, "Door open");
+			displayFloorMessage(c, "Arrived on %d", c->currentFloor, c->doorOpen);
+			break;
+		case DOOR_EVT_CLOSING:
+			strcpy(c->doorOpen, "Door closing");
+			displayFloorMessage(c, "Arrived on %d", c->currentFloor, c->doorOpen);
+			break;
+		case DOOR_EVT_CLOSED:
+			event_post_car(i, EVT_DOOR_TIMEOUT, DOOR_CYCLED);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+// Rough time until car could serve call: travel along its LOOK sweep plus a
+// fixed cost for every stop made on the way
+uint32_t elevator_serve_time(uint8_t car, uint8_t call)
+{
+	const Car *c = &cars[car];
+	uint8_t floor = call & CALL_FLOOR_MASK;
+	uint8_t from = c->currentFloor;
+	Direction dir = c->travelDir;
+	uint8_t turn = floor;
+	uint8_t distance;
+	uint8_t stops;
+	uint32_t time = 0;
+
+	switch (c->state)
+	{
+	case FAULT:
+	case EMERGENCY:
+		return SERVE_TIME_NONE;
+	case RECOVERING:
+		time = param(PARAM_RECOVER);
+		break;
+	case MOVING:
+		from = motion_stop_floor(&c->motion);
+		break;
+	case DOOR_OPEN:
+		time = param(PARAM_DWELL_CAR) + param(PARAM_DOOR_CLOSE);
+		break;
+	default:
+		break;
+	}
+
+	// A call behind the car, or one wanting the other way, waits for the turn
+	if ((dir != DIR_NONE) && (floor != from) &&
+		(((dir == DIR_UP) != (floor > from)) || ((call & CALL_TYPE_MASK) == ((dir == DIR_UP) ? CALL_HALL_DOWN : CALL_HALL_UP))))
+	{
+		turn = calls_farthest(&c->calls, from, dir);
+		if ((dir == DIR_UP) ? (floor > turn) : (floor < turn))
+		{
+			turn = floor;
+		}
+	}
+
+	distance = ((turn > from) ? (turn - from) : (from - turn)) + ((turn > floor) ? (turn - floor) : (floor - turn));
+	stops = calls_between(&c->calls, from, turn) + calls_between(&c->calls, turn, floor) + ((turn != from) && (turn != floor));
+	if (distance > 0)
+	{
+		time += motion_trip_time_ms(distance);
+	}
+	return time + stops * STOP_COST_MS;
+}
+
+ElevatorState elevator_state(uint8_t car)
+{
+	return cars[car].state;
+}
+
+PGM_P elevator_state_name(ElevatorState state)
+{
+	return (PGM_P)pgm_read_word(&stateNames[state]);
+}
+
+uint8_t elevator_current_floor(uint8_t car)
+{
+	return cars[car].currentFloor;
+}
+
+bool elevator_stopped(void)
+{
+	for (uint8_t i = 0; i < CAR_COUNT; i++)
+	{
+		if (motion_moving(&cars[i].motion))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool elevator_set_floor_height(uint16_t mm)
+{
+	uint8_t floors[CAR_COUNT];
+
+	if (!elevator_stopped())
+	{
+		return false; // A trip in progress has its target in mm of the old height
+	}
+	for (uint8_t i = 0; i < CAR_COUNT; i++)
+	{
+		floors[i] = motion_floor(&cars[i].motion); // With the old height
+	}
+	motionProfile.floorHeight = mm;
+	for (uint8_t i = 0; i < CAR_COUNT; i++)
+	{
+		motion_init(&cars[i].motion, floors[i]);
+	}
+	return true;
+}
+
+void elevator_resume_report(void)
+{
+	for (uint8_t i = 0; i < CAR_COUNT; i++)
+	{
+		if (cars[i].resumed)
+		{
+			printf("Car %d resumed on %d\n", i, cars[i].currentFloor);
+		}
+	}
+}
+
+void elevator_trace_dump(void)
+{
+	traceDumpIndex = (traceHead - traceCount) & FSM_TRACE_MASK; // Oldest entry
+	traceDumpLeft = traceCount;
+}
+
+bool elevator_trace_line(void)
+{
+	TraceEntry *t = &trace[traceDumpIndex];
+
+	if (traceDumpLeft == 0)
+	{
+		return false;
+	}
+	printf_P(PSTR("%5u %u %S -%u-> %S\n"), t->time, t->car, (PGM_P)pgm_read_word(&stateNames[t->state]), t->event,
+			 (PGM_P)pgm_read_word(&stateNames[t->next]));
+	traceDumpIndex = (traceDumpIndex + 1) & FSM_TRACE_MASK;
+	traceDumpLeft--;
+	return true;
+}
@@ -0,0 +1,67 @@
+/*
+ * elevator.h
+ *
+ * Created: 16.10.2026
+ *
+ * Table driven elevator FSM. Every (state, event) pair maps to an action
+ * and a next state in a table kept in flash, so dispatching an event is a
+ * single table lookup. Events come from the queue in events.h.
+ *
+ * Runs one FSM per car of the group (CAR_COUNT in slave_comm.h). Hall calls
+ * go to the car with the lowest estimated time to serve them, car calls to
+ * the car whose door opened last.
+ */
+
+#ifndef ELEVATOR_H
+#define ELEVATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+#include "slave_comm.h"
+
+// Elevator FSM states
+typedef enum
+{
+	IDLE,
+	FLOOR_SELECTED,
+	MOVING,
+	FAULT,
+	DOOR_OPEN,
+	EMERGENCY,	// Waiting for a key press to acknowledge the emergency
+	RECOVERING, // Hold after an acknowledged emergency
+	STATE_COUNT
+} ElevatorState;
+
+// Fault codes carried by EVT_FAULT
+#define FAULT_EVENT_OVERFLOW 1 // Event queue was full, an event was lost
+#define FAULT_NO_TIMER 2		 // No free scheduler timer for a delay
+#define FAULT_NO_CALL 3		 // Asked to dispatch with no call registered
+#define FAULT_STACK 4		 // Stack headroom below STACK_GUARD_BYTES
+
+#define FSM_TRACE_SIZE 16 // Transitions kept in RAM, power of two
+
+void elevator_init(void);
+void elevator_resume_report(void); // Cars restored by elevator_init(), printed once the boot is timed
+void elevator_task(void);
+void elevator_motion_task(void); // Every MOTION_TICK_MS
+void elevator_door_task(void);	 // Every DOOR_TICK_MS
+
+ElevatorState elevator_state(uint8_t car);
+PGM_P elevator_state_name(ElevatorState state);
+uint8_t elevator_current_floor(uint8_t car);
+bool elevator_stopped(void); // No car is travelling or levelling
+
+// Changes motionProfile.floorHeight and moves every car's position to the
+// new scale. Refused (false) unless elevator_stopped().
+bool elevator_set_floor_height(uint16_t mm);
+
+// Estimated ms until car could stop for call (CALL_xxx | floor)
+uint32_t elevator_serve_time(uint8_t car, uint8_t call);
+
+// Print the most recent transitions over UART, oldest first. The dump only
+// starts the listing, elevator_trace_line() prints one entry per call.
+void elevator_trace_dump(void);
+bool elevator_trace_line(void); // False once the listing is done
+
+#endif // ELEVATOR_H
@@ -0,0 +1,91 @@
+/*
+ * emergency.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "emergency.h"
+#include "timer.h"
+#include <util/atomic.h>
+
+static uint8_t highSamples = 0;				// Consecutive high samples of PA0
+static bool released = true;				// Pin has been low since the last latch
+static uint32_t pressedAt = 0;				// Timestamp of the first high sample (us)
+static volatile bool latched = false;		// Debounced press waiting for the FSM
+static volatile uint32_t latchedPressAt = 0; // pressedAt of the latched press
+static uint32_t lastLatency = 0;
+static uint32_t maxLatency = 0;
+
+void emergency_init(void)
+{
+	DDRA &= ~(1 << PA0); // Emergency button input
+}
+
+void emergency_sample(void)
+{
+	if (!(PINA & (1 << PA0)))
+	{
+		highSamples = 0;
+		released = true;
+		return;
+	}
+
+	if (highSamples == 0)
+	{
+		pressedAt = timer_micros(); // Start of the press, latency is measured from here
+	}
+	if (highSamples < EMERGENCY_DEBOUNCE_MS)
+	{
+		highSamples++;
+	}
+
+	if ((highSamples == EMERGENCY_DEBOUNCE_MS) && released)
+	{
+		released = false; // One event per press, holding the button does not repeat it
+		latchedPressAt = pressedAt;
+		latched = true;
+	}
+}
+
+void emergency_trigger(void)
+{
+	uint32_t now = timer_micros();
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // The sampling ISR latches too
+	{
+		latchedPressAt = now;
+		latched = true;
+	}
+}
+
+bool emergency_pending(void)
+{
+	return latched;
+}
+
+void emergency_acknowledge(void)
+{
+	uint32_t pressTime;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		pressTime = latchedPressAt;
+		latched = false;
+	}
+
+	lastLatency = timer_micros() - pressTime;
+	if (lastLatency > maxLatency)
+	{
+		maxLatency = lastLatency;
+	}
+}
+
+uint32_t emergency_last_latency_us(void)
+{
+	return lastLatency;
+}
+
+uint32_t emergency_max_latency_us(void)
+{
+	return maxLatency;
+}
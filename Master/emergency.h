@@ -0,0 +1,41 @@
+/*
+ * emergency.h
+ *
+ * Created: 16.10.2026
+ *
+ * Emergency button on PA0. PORTA has no external or pin change interrupt
+ * on the ATmega2560, so the pin is sampled from the 1 ms timer interrupt
+ * instead. A press is latched after EMERGENCY_DEBOUNCE_MS consecutive high
+ * samples, which bounds the detection delay no matter what the main loop
+ * is doing.
+ */
+
+#ifndef EMERGENCY_H
+#define EMERGENCY_H
+
+#include <avr/io.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EMERGENCY_DEBOUNCE_MS 3 // High samples needed before a press counts
+
+void emergency_init(void);
+
+// Called from the timer ISR once per millisecond
+void emergency_sample(void);
+
+// Latches a press as if it came from the button, for the console. The
+// FSM handles it, counts it and measures its latency the same way.
+void emergency_trigger(void);
+
+// True once a debounced press has been latched and not yet acknowledged
+bool emergency_pending(void);
+
+// Called by the FSM when it starts handling the emergency. Records the time
+// from the first high sample to this call.
+void emergency_acknowledge(void);
+
+uint32_t emergency_last_latency_us(void);
+uint32_t emergency_max_latency_us(void);
+
+#endif // EMERGENCY_H
@@ -0,0 +1,321 @@
+/*
+ * eventlog.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "eventlog.h"
+#include "eeprom_map.h"
+#include "timer.h"
+#include "../Common/ringbuf.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+
+#define PAGE_COUNT (EEPROM_LOG_SIZE / EVENTLOG_PAGE_SIZE)
+#define PAGE_ADDR(p) (EEPROM_LOG_START + (uint16_t)(p) * EVENTLOG_PAGE_SIZE)
+#define SEQ_MASK 0x7F // Page sequence numbers, bit 7 set = erased
+#define SEQ_NEWER(a, b) ((uint8_t)((((a) - (b)) & SEQ_MASK) - 1) < (SEQ_MASK / 2)) // a is 1..63 pages after b
+#define END_MARK 0xFF // Header of an erased byte, ends the entries of a page
+#define ENTRY_MAX 8	  // Header, 5 byte varint, 2 arguments
+
+typedef struct
+{
+	uint16_t addr;
+	uint8_t data;
+} PendingByte;
+
+RINGBUF_DEFINE(pending, PendingByte, EVENTLOG_QUEUE_SIZE);
+
+// Filled by eventlog_write(), emptied by the EEPROM ready interrupt
+static pending_t queue;
+static volatile bool suspended = false;
+
+static uint8_t page = PAGE_COUNT - 1; // Page being filled
+static uint8_t pageSeq = SEQ_MASK;
+static uint8_t pageUsed = EVENTLOG_PAGE_SIZE; // A full page makes the next entry open a new one
+static uint32_t lastTime = 0;
+static uint16_t dropped = 0;
+
+// Dump position, dumpCount pages left to print
+static uint8_t dumpPage = 0;
+static uint8_t dumpCount = 0;
+static uint8_t dumpOffset = 0;
+static uint32_t dumpTime = 0;
+
+static const uint8_t argCount[LOG_TYPE_COUNT] PROGMEM = {
+	[LOG_BOOT] = 1,
+	[LOG_TRIP_START] = 2,
+	[LOG_TRIP_END] = 2,
+	[LOG_DOOR_CYCLE] = 1,
+	[LOG_EMERGENCY] = 1,
+	[LOG_FAULT] = 1,
+	[LOG_TRAFFIC_MODE] = 1,
+};
+
+static const char logBoot[] PROGMEM = "BOOT";
+static const char logTripStart[] PROGMEM = "TRIP_START";
+static const char logTripEnd[] PROGMEM = "TRIP_END";
+static const char logDoorCycle[] PROGMEM = "DOOR_CYCLE";
+static const char logEmergency[] PROGMEM = "EMERGENCY";
+static const char logFault[] PROGMEM = "FAULT";
+static const char logTrafficMode[] PROGMEM = "TRAFFIC_MODE";
+
+static PGM_P const logNames[LOG_TYPE_COUNT] PROGMEM = {
+	logBoot, logTripStart, logTripEnd, logDoorCycle, logEmergency, logFault, logTrafficMode};
+
+// Programs one queued byte per interrupt, bytes that already hold the value
+// are skipped so they cost no wear
+ISR(EE_READY_vect)
+{
+	PendingByte *next = pending_peek(&queue);
+
+	if (next == NULL)
+	{
+		EECR &= ~(1 << EERIE); // Queue empty, sleep until the next entry
+		return;
+	}
+
+	EEAR = next->addr;
+	EECR |= (1 << EERE);
+	if (EEDR != next->data)
+	{
+		EEDR = next->data;
+		EECR |= (1 << EEMPE);
+		EECR |= (1 << EEPE);
+	}
+	pending_drop(&queue);
+}
+
+// Room was checked by the caller
+static void push(uint16_t addr, uint8_t data)
+{
+	PendingByte b = {addr, data};
+
+	pending_push(&queue, b);
+}
+
+// Length of the entry at addr, 0 if there is none or it does not fit in room
+static uint8_t entryLength(uint16_t addr, uint8_t room)
+{
+	uint8_t header = eeprom_read_byte(EEPROM_ADDR(addr));
+	uint8_t len = 1;
+
+	if ((header == END_MARK) || ((header >> 4) >= LOG_TYPE_COUNT))
+	{
+		return 0;
+	}
+	while ((len < room) && (eeprom_read_byte(EEPROM_ADDR(addr + len)) & 0x80))
+	{
+		len++; // Varint continuation
+	}
+	len += 1 + pgm_read_byte(&argCount[header >> 4]);
+	return (len <= room) ? len : 0;
+}
+
+void eventlog_init(void)
+{
+	bool found = false;
+
+	for (uint8_t p = 0; p < PAGE_COUNT; p++)
+	{
+		uint8_t seq = eeprom_read_byte(EEPROM_ADDR(PAGE_ADDR(p)));
+
+		if ((seq & ~SEQ_MASK) == 0 && (!found || SEQ_NEWER(seq, pageSeq)))
+		{
+			page = p;
+			pageSeq = seq;
+			found = true;
+		}
+	}
+	if (!found)
+	{
+		return; // Blank log, the first entry opens page 0
+	}
+
+	// Walk the entries of the newest page to find its end
+	pageUsed = 1;
+	while (pageUsed < EVENTLOG_PAGE_SIZE)
+	{
+		uint8_t len = entryLength(PAGE_ADDR(page) + pageUsed, EVENTLOG_PAGE_SIZE - pageUsed);
+
+		if (len == 0)
+		{
+			if (eeprom_read_byte(EEPROM_ADDR(PAGE_ADDR(page) + pageUsed)) != END_MARK)
+			{
+				pageUsed = EVENTLOG_PAGE_SIZE; // Torn entry, continue on a fresh page
+			}
+			break;
+		}
+		pageUsed += len;
+	}
+}
+
+// Encodes the entry into the queue, the EEPROM is written later by the ISR
+void eventlog_write(LogType type, uint8_t car, uint8_t arg1, uint8_t arg2)
+{
+	uint8_t entry[ENTRY_MAX];
+	uint8_t len = 0;
+	uint8_t args = pgm_read_byte(&argCount[type]);
+	uint32_t now = timer_millis();
+	uint32_t delta = (type == LOG_BOOT) ? 0 : (now - lastTime);
+	uint16_t base;
+
+	entry[len++] = (type << 4) | (car & 0x0F);
+	do
+	{
+		entry[len] = delta & 0x7F;
+		delta >>= 7;
+		if (delta)
+		{
+			entry[len] |= 0x80;
+		}
+		len++;
+	} while (delta);
+	if (args > 0)
+	{
+		entry[len++] = arg1;
+	}
+	if (args > 1)
+	{
+		entry[len++] = arg2;
+	}
+
+	// Room for the entry, a page header and the end mark
+	if (pending_space(&queue) < len + 2)
+	{
+		dropped++;
+		return;
+	}
+	lastTime = now;
+
+	if (pageUsed + len > EVENTLOG_PAGE_SIZE)
+	{
+		page = (page + 1) % PAGE_COUNT;
+		pageSeq = (pageSeq + 1) & SEQ_MASK;
+		pageUsed = 1;
+	}
+	base = PAGE_ADDR(page);
+	for (uint8_t i = 0; i < len; i++)
+	{
+		push(base + pageUsed + i, entry[i]);
+	}
+	if (pageUsed + len < EVENTLOG_PAGE_SIZE)
+	{
+		push(base + pageUsed + len, END_MARK); // Overwritten by the next entry
+	}
+	if (pageUsed == 1)
+	{
+		push(base, pageSeq); // Claim the page last, a torn first entry leaves it old
+	}
+	pageUsed += len;
+
+	if (!suspended)
+	{
+		EECR |= (1 << EERIE);
+	}
+}
+
+uint16_t eventlog_dropped(void)
+{
+	return dropped;
+}
+
+void eventlog_suspend(void)
+{
+	suspended = true;
+	EECR &= ~(1 << EERIE);
+}
+
+void eventlog_resume(void)
+{
+	suspended = false;
+	if (!pending_empty(&queue))
+	{
+		EECR |= (1 << EERIE);
+	}
+}
+
+void eventlog_dump(void)
+{
+	dumpPage = (page + 1) % PAGE_COUNT; // Oldest page follows the one being filled
+	dumpCount = PAGE_COUNT;
+	dumpOffset = 0;
+	dumpTime = 0;
+}
+
+static void nextDumpPage(void)
+{
+	dumpPage = (dumpPage + 1) % PAGE_COUNT;
+	dumpOffset = 0;
+	if (--dumpCount == 0)
+	{
+		printf_P(PSTR("End of log, %u dropped\n"), dropped);
+	}
+}
+
+void eventlog_task(void)
+{
+	uint8_t entry[ENTRY_MAX];
+	uint8_t len;
+	uint8_t type;
+	uint16_t base = PAGE_ADDR(dumpPage);
+	uint32_t delta = 0;
+
+	if (dumpCount == 0)
+	{
+		return;
+	}
+
+	eventlog_suspend(); // The ISR must not touch EEAR while we read
+	if (dumpOffset == 0)
+	{
+		len = eeprom_read_byte(EEPROM_ADDR(base)) & ~SEQ_MASK; // Page header, set = erased
+		eventlog_resume();
+		if (len)
+		{
+			nextDumpPage();
+		}
+		else
+		{
+			dumpOffset = 1;
+		}
+		return;
+	}
+	len = entryLength(base + dumpOffset, EVENTLOG_PAGE_SIZE - dumpOffset);
+	eeprom_read_block(entry, EEPROM_ADDR(base + dumpOffset), len);
+	eventlog_resume();
+
+	if (len == 0)
+	{
+		nextDumpPage();
+		return;
+	}
+
+	type = entry[0] >> 4;
+	for (uint8_t i = 1, shift = 0; i < len; i++, shift += 7)
+	{
+		delta |= (uint32_t)(entry[i] & 0x7F) << shift;
+		if (!(entry[i] & 0x80))
+		{
+			break;
+		}
+	}
+	dumpTime = (type == LOG_BOOT) ? 0 : (dumpTime + delta);
+
+	printf_P(PSTR("%lu.%03lu car %u %S"), dumpTime / 1000, dumpTime % 1000, entry[0] & 0x0F,
+			 (PGM_P)pgm_read_word(&logNames[type]));
+	for (uint8_t i = len - pgm_read_byte(&argCount[type]); i < len; i++)
+	{
+		printf_P(PSTR(" %u"), entry[i]);
+	}
+	printf_P(PSTR("\n"));
+
+	dumpOffset += len;
+	if (dumpOffset >= EVENTLOG_PAGE_SIZE)
+	{
+		nextDumpPage();
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ * eventlog.h
+ *
+ * Created: 16.10.2026
+ *
+ * Binary log of what the elevator did, kept in EEPROM across resets.
+ * eventlog_write() only encodes the entry into a RAM queue, the EEPROM
+ * ready interrupt programs it one byte at a time in the background.
+ *
+ * Layout: the log region is a ring of EVENTLOG_PAGE_SIZE byte pages. Each
+ * page starts with a 7 bit sequence number (0xFF = erased) followed by
+ * entries, an 0xFF header ends the page early. Every byte is written once
+ * per turn of the ring. An entry is a header byte (type << 4 | car), the
+ * time since the previous entry in ms as a 7 bit varint, then the
+ * arguments of its type.
+ */
+
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EVENTLOG_PAGE_SIZE 64
+#define EVENTLOG_QUEUE_SIZE 64 // Bytes waiting for the EEPROM, power of two
+
+typedef enum
+{
+	LOG_BOOT,		  // arg = MCUSR, time restarts at 0
+	LOG_TRIP_START,	  // args = from, to
+	LOG_TRIP_END,	  // args = floor, duration in 0.1 s
+	LOG_DOOR_CYCLE,	  // arg = floor
+	LOG_EMERGENCY,	  // arg = floor
+	LOG_FAULT,		  // arg = fault code
+	LOG_TRAFFIC_MODE, // arg = TrafficMode
+	LOG_TYPE_COUNT
+} LogType;
+
+// Finds the end of the log, call before interrupts are enabled
+void eventlog_init(void);
+
+void eventlog_write(LogType type, uint8_t car, uint8_t arg1, uint8_t arg2);
+
+// Start printing the log over UART, oldest entry first
+void eventlog_dump(void);
+void eventlog_task(void); // Every scheduler pass, prints one entry while dumping
+
+// Entries lost because the queue was full
+uint16_t eventlog_dropped(void);
+
+// Other EEPROM writers must hold the log interrupt off while they access
+// the EEPROM registers
+void eventlog_suspend(void);
+void eventlog_resume(void);
+
+#endif // EVENTLOG_H
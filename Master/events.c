@@ -0,0 +1,59 @@
+/*
+ * events.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "events.h"
+
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_SIZE - 1)
+
+static Event queue[EVENT_QUEUE_SIZE];
+static uint8_t head = 0; // Next free slot
+static uint8_t tail = 0; // Oldest event
+static bool overflow = false;
+
+bool event_post(EventType type, uint8_t arg)
+{
+	return event_post_car(EVENT_GROUP, type, arg);
+}
+
+bool event_post_car(uint8_t car, EventType type, uint8_t arg)
+{
+	uint8_t next = (head + 1) & EVENT_QUEUE_MASK;
+
+	if (next == tail)
+	{
+		overflow = true;
+		return false;
+	}
+	queue[head].type = type;
+	queue[head].car = car;
+	queue[head].arg = arg;
+	head = next;
+	return true;
+}
+
+bool event_get(Event *event)
+{
+	if (tail == head)
+	{
+		return false;
+	}
+	*event = queue[tail];
+	tail = (tail + 1) & EVENT_QUEUE_MASK;
+	return true;
+}
+
+void event_flush(void)
+{
+	tail = head;
+}
+
+bool event_overflowed(void)
+{
+	bool dropped = overflow;
+
+	overflow = false;
+	return dropped;
+}
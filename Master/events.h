@@ -0,0 +1,56 @@
+/*
+ * events.h
+ *
+ * Created: 16.10.2026
+ *
+ * Fixed size FIFO of events for the elevator FSM. Producers (keypad task,
+ * scheduler timers, ...) post events, elevator_task() drains the queue and
+ * dispatches each event through the transition table. Only used from the
+ * main loop, interrupts report through flags that a task turns into events.
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EVENT_QUEUE_SIZE 16 // Power of two
+
+typedef enum
+{
+	EVT_KEY_PRESSED,   // arg = ASCII key
+	EVT_KEY_CONFIRMED, // arg = CALL_xxx | floor entered on the keypad
+	EVT_DISPATCH,	   // Calls are pending while the car is idle
+	EVT_TIMEOUT,	   // FSM step delay expired
+	EVT_FLOOR_PASSED,  // Car is closest to another landing, arg = floor
+	EVT_FLOOR_REACHED, // Car is level with the selected floor
+	EVT_DOOR_TIMEOUT,  // Door dwell expired and the door has closed, arg = 1 if it had opened
+	EVT_DOOR_CLOSE,	   // Door close key
+	EVT_DOOR_REOPEN,   // Door reopen key
+	EVT_PARK,		   // Move the idle car, arg = parking floor
+	EVT_EMERGENCY,	   // Emergency button latched
+	EVT_FAULT,		   // Internal error, arg = fault code
+	EVT_SLAVE_DONE,	   // Slave raised attention, its effects are over and all commands carried out
+	EVT_COUNT
+} EventType;
+
+#define EVENT_GROUP 0xFF // Event.car of events for the whole group (keypad, emergency)
+
+typedef struct
+{
+	uint8_t type; // EventType
+	uint8_t car;  // Car the event is for, or EVENT_GROUP
+	uint8_t arg;
+} Event;
+
+// Returns false if the queue is full and the event was dropped
+bool event_post(EventType type, uint8_t arg); // Group event
+bool event_post_car(uint8_t car, EventType type, uint8_t arg);
+bool event_get(Event *event);
+void event_flush(void);
+
+// True if an event was dropped since the last call, clears the flag
+bool event_overflowed(void);
+
+#endif // EVENTS_H
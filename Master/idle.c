@@ -0,0 +1,82 @@
+/*
+ * idle.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "idle.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "prof.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+
+static uint32_t asleepUs = 0; // Below one millisecond, carried into asleepMs
+static uint32_t asleepMs = 0;
+static uint32_t windowStart = 0; // timer_millis() of the previous report
+
+void idle_init(void)
+{
+	ACSR |= (1 << ACD); // Analog comparator off
+	power_adc_disable();
+	power_spi_disable();
+	power_timer1_disable();
+	power_timer2_disable();
+	power_timer3_disable();
+	power_timer4_disable();
+#if !PROFILE
+	power_timer5_disable(); // Cycle counter of the profiler
+#endif
+	power_usart1_disable();
+	power_usart2_disable();
+	power_usart3_disable();
+	windowStart = timer_millis();
+}
+
+void idle_sleep(void)
+{
+	uint32_t start;
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	cli();
+	if (!sched_idle())
+	{
+		sei(); // A tick went by during the pass, run the next one at once
+		return;
+	}
+	start = timer_micros();
+	sleep_enable();
+	sei(); // The instruction after sei runs first, no wake-up can be missed
+	sleep_cpu();
+	sleep_disable();
+
+	asleepUs += timer_micros() - start; // The waking ISR has already run
+	while (asleepUs >= 1000)
+	{
+		asleepUs -= 1000;
+		asleepMs++;
+	}
+}
+
+void idle_report(void)
+{
+	uint32_t window = timer_millis() - windowStart;
+	uint16_t awake; // 0.1 %
+	uint32_t current;
+
+	if (window == 0)
+	{
+		return;
+	}
+	awake = (asleepMs >= window) ? 0 : (uint16_t)(1000 - (uint64_t)asleepMs * 1000 / window);
+	current = ((uint32_t)awake * IDLE_ACTIVE_UA + (uint32_t)(1000 - awake) * IDLE_SLEEP_UA) / 1000;
+	printf_P(PSTR("Awake %u.%u%% of %lu ms, about %lu.%lu mA\n"), awake / 10, awake % 10, window, current / 1000,
+			 (current % 1000) / 100);
+
+	asleepMs = 0;
+	windowStart += window;
+}
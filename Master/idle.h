@@ -0,0 +1,37 @@
+/*
+ * idle.h
+ *
+ * Created: 16.10.2026
+ *
+ * Sleeps the Master between scheduler passes. When a pass finishes inside
+ * the same millisecond it started, the CPU enters SLEEP_MODE_IDLE until the
+ * next interrupt: the 1 ms tick at the latest, or the UART, TWI or EEPROM
+ * interrupts earlier. Unused peripherals are powered down at init. The
+ * time spent asleep is measured to give a duty cycle and a current
+ * estimate.
+ */
+
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+// Rough ATmega2560 supply current at 16 MHz and 5 V, MCU only. Override
+// with figures measured on the board for a better estimate.
+#ifndef IDLE_ACTIVE_UA
+#define IDLE_ACTIVE_UA 20000
+#endif
+#ifndef IDLE_SLEEP_UA
+#define IDLE_SLEEP_UA 5000
+#endif
+
+// Powers down the peripherals nothing uses
+void idle_init(void);
+
+// Called at the end of every main loop pass
+void idle_sleep(void);
+
+// Duty cycle and estimated current since the previous report
+void idle_report(void);
+
+#endif // IDLE_H
@@ -74,6 +74,7 @@ Errors and omissions should be reported to codelibraries@exploreembedded.com
 
 #include "keypad.h"
 #include "delay.h"
+#include "prof.h"
 
 
 
@@ -82,6 +83,7 @@ Errors and omissions should be reported to codelibraries@exploreembedded.com
                            local function prototypes
  ***************************************************************************************************/
 static uint8_t keypad_ScanKey();
+static uint8_t keypad_DecodeKey(uint8_t var_keyScanCode_u8);
 /**************************************************************************************************/
 
 
@@ -201,26 +203,8 @@ uint8_t KEYPAD_GetKey()
 	KEYPAD_WaitForKeyPress();      // Wait for the new key press
 	var_keyPress_u8 = keypad_ScanKey();        // Scan for the key pressed.
 
-	switch(var_keyPress_u8)                       // Decode the key
-	{
-	case 0xe7: var_keyPress_u8='*'; break; 
-	case 0xeb: var_keyPress_u8='7'; break; 
-	case 0xed: var_keyPress_u8='4'; break; 
-	case 0xee: var_keyPress_u8='1'; break; 
-	case 0xd7: var_keyPress_u8='0'; break; 
-	case 0xdb: var_keyPress_u8='8'; break; 
-	case 0xdd: var_keyPress_u8='5'; break; 
-	case 0xde: var_keyPress_u8='2'; break; 
-	case 0xb7: var_keyPress_u8='#'; break; 
-	case 0xbb: var_keyPress_u8='9'; break; 
-	case 0xbd: var_keyPress_u8='6'; break; 
-	case 0xbe: var_keyPress_u8='3'; break; 
-	case 0x77: var_keyPress_u8='D'; break;  
-	case 0x7b: var_keyPress_u8='C'; break;  
-	case 0x7d: var_keyPress_u8='B'; break;  
-	case 0x7e: var_keyPress_u8='A'; break;  
-	default  : var_keyPress_u8='z'; break;
-	}
+	var_keyPress_u8 = keypad_DecodeKey(var_keyPress_u8); // Decode the key
+
 	return(var_keyPress_u8);                      // Return the key
 }
 
@@ -229,6 +213,66 @@ uint8_t KEYPAD_GetKey()
 
 
 
+/***************************************************************************************************
+                   uint8_t KEYPAD_ReadKey()
+ ***************************************************************************************************
+ * I/P Arguments:none
+
+ * Return value	: uint8_t--> ASCII value of the Key Pressed, 'z' if no key is pressed
+
+ * description: This function returns immediately with the key that is currently held down.
+                It does not wait for a release or a new press, so the caller has to debounce
+				and detect the press/release edges itself (see keypad_task()).
+ ***************************************************************************************************/
+uint8_t KEYPAD_ReadKey()
+{
+	M_ROW=0x0F;                              // Pull the ROW lines to low and Column lines high.
+	if((M_COL & 0x0F)==0x0F)                 // No column pulled low, no key pressed
+		return('z');
+
+	return(keypad_DecodeKey(keypad_ScanKey())); // Scan and decode the key pressed
+}
+
+
+
+
+/***************************************************************************************************
+                     static uint8_t keypad_DecodeKey()
+ ***************************************************************************************************
+ * I/P Arguments: uint8_t--> Scancode returned by keypad_ScanKey()
+
+ * Return value	: uint8_t--> ASCII value of the Key, 'z' for an unknown scancode
+
+ * description  : This function maps the ROW-COL scancode to the ASCII value of the key.
+ ***************************************************************************************************/
+static uint8_t keypad_DecodeKey(uint8_t var_keyScanCode_u8)
+{
+	switch(var_keyScanCode_u8)                    // Decode the key
+	{
+	case 0xe7: var_keyScanCode_u8='*'; break; 
+	case 0xeb: var_keyScanCode_u8='7'; break; 
+	case 0xed: var_keyScanCode_u8='4'; break; 
+	case 0xee: var_keyScanCode_u8='1'; break; 
+	case 0xd7: var_keyScanCode_u8='0'; break; 
+	case 0xdb: var_keyScanCode_u8='8'; break; 
+	case 0xdd: var_keyScanCode_u8='5'; break; 
+	case 0xde: var_keyScanCode_u8='2'; break; 
+	case 0xb7: var_keyScanCode_u8='#'; break; 
+	case 0xbb: var_keyScanCode_u8='9'; break; 
+	case 0xbd: var_keyScanCode_u8='6'; break; 
+	case 0xbe: var_keyScanCode_u8='3'; break; 
+	case 0x77: var_keyScanCode_u8='D'; break;  
+	case 0x7b: var_keyScanCode_u8='C'; break;  
+	case 0x7d: var_keyScanCode_u8='B'; break;  
+	case 0x7e: var_keyScanCode_u8='A'; break;  
+	default  : var_keyScanCode_u8='z'; break;
+	}
+	return(var_keyScanCode_u8);
+}
+
+
+
+
 /***************************************************************************************************
                      static uint8_t keypad_ScanKey()
  ***************************************************************************************************
@@ -248,6 +292,7 @@ static uint8_t keypad_ScanKey()
 
 	uint8_t var_keyScanCode_u8 = 0xEF,i, var_keyPress_u8;
 
+	PROF_ENTER(PROF_KEYPAD_SCAN);
 	for(i=0;i<0x04;i++)                // Scan All the 4-Rows for key press
 	{
 		M_ROW=var_keyScanCode_u8;        // Select 1-Row at a time for Scanning the Key
@@ -260,5 +305,6 @@ static uint8_t keypad_ScanKey()
 		var_keyScanCode_u8=((var_keyScanCode_u8<<1)+0x01); // Rotate the ScanKey to SCAN the remaining Rows
 	}
 	var_keyPress_u8 = var_keyPress_u8 + (var_keyScanCode_u8 & 0xf0); // Return the row and COL status to decode the key
+	PROF_EXIT(PROF_KEYPAD_SCAN);
 	return(var_keyPress_u8);
 }
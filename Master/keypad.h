@@ -64,6 +64,7 @@ void KEYPAD_Init();
 void KEYPAD_WaitForKeyRelease();
 void KEYPAD_WaitForKeyPress();
 uint8_t KEYPAD_GetKey();
+uint8_t KEYPAD_ReadKey();
 /**************************************************************************************************/
 
 #endif
@@ -7,62 +7,130 @@
 
 #include "keypad_handler.h"
 #include "lcd_handler.h" // So you can call write_to_lcd()
+#include "events.h"
+#include "calls.h"
 
-// This function is used to wait for keypad input in case of emergencies
-int handleEmergencyKey(void)
+static uint8_t lastSample = KEYPAD_NO_KEY; // Raw key seen on the previous scan
+static uint8_t stableCount = 0;			  // How many scans lastSample has stayed the same
+static uint8_t stableKey = KEYPAD_NO_KEY;  // Debounced key state
+
+static char floorDigits[3] = {0}; // to store two digits and null-terminator
+static uint8_t floorIndex = 0;
+static uint8_t callType = CALL_CAR; // Set by the 'A'/'B' hall call keys
+
+// Scans the keypad once and reports a new key press after it has been stable
+// for KEYPAD_DEBOUNCE_SCANS scans. Never waits for a press or a release.
+void keypad_task(void)
 {
-	while (1)
+	uint8_t sample = KEYPAD_ReadKey();
+
+	if (sample != lastSample)
+	{
+		lastSample = sample; // Still bouncing, start counting again
+		stableCount = 0;
+		return;
+	}
+
+	if (stableCount < KEYPAD_DEBOUNCE_SCANS)
 	{
-		uint8_t key_signal = KEYPAD_GetKey(); // This function returns the pressed keypad key
+		stableCount++;
+		return;
+	}
 
-		// If any valid key is pressed return 1 to exit loop
-		if (key_signal != 0xFF)
+	if (sample != stableKey)
+	{
+		stableKey = sample;
+		if (sample != KEYPAD_NO_KEY) // Only presses are events, releases just re-arm
 		{
-			return 1;
+			event_post(EVT_KEY_PRESSED, sample);
+			handle_keypad_input(sample);
 		}
 	}
 }
 
 // This function is based on LUT Inroduction To Embeded Systems course Exercise 3 example solution
-// This function handles the input loop for entering floors
-int handle_keypad_input(void)
+// Text shown above the digits for the kind of call being entered
+static const char *entryTitle(void)
 {
-	char floor[3] = {0}; // to store two digits and null-terminator
-	uint8_t index = 0;
-
-	while (1)
+	switch (callType)
 	{
-		uint8_t key_signal = KEYPAD_GetKey(); // This function returns the pressed keypad key
-
-		if (key_signal != 0xFF && key_signal >= '0' && key_signal <= '9') // Accept all number keys with value between 0 and 9
-		{
-			if (index < 2) // if there are less that 2 numbers selected
-			{
-				floor[index++] = key_signal; // add the the pressed key to to the selected floor
-			}
-			else
-			{
-				// If more than 2 digits entered set the floor to 0
-				floor[0] = '0';
-				floor[1] = '\0';
+	case CALL_HALL_UP:
+		return "Hall call up";
+	case CALL_HALL_DOWN:
+		return "Hall call down";
+	default:
+		return "Choose floor";
+	}
+}
 
-				// Start the floor selection over again
-				index = 0;
-			}
+static void clearEntry(void)
+{
+	floorDigits[0] = floorDigits[1] = floorDigits[2] = '\0';
+	floorIndex = 0;
+	callType = CALL_CAR;
+}
 
-			write_to_lcd("Choose floor", floor);
-			_delay_ms(300); // debounce delay
+// This function handles the input for entering floors, one key press per call.
+// Digits then '#' enter a car call, 'A' or 'B' first makes it an up or down
+// hall call and '*' cancels the entry. 'C' and 'D' are the door close and
+// reopen buttons. Accepted in every state, the call is posted as
+// EVT_KEY_CONFIRMED once '#' confirms it.
+void handle_keypad_input(uint8_t key_signal)
+{
+	if (key_signal >= '0' && key_signal <= '9') // Accept all number keys with value between 0 and 9
+	{
+		if (floorIndex < 2) // if there are less that 2 numbers selected
+		{
+			floorDigits[floorIndex++] = key_signal; // add the the pressed key to to the selected floor
 		}
-		else if (key_signal == '#') // '#' used to confirm entry of floor
+		else
 		{
-			break;
+			// If more than 2 digits entered set the floor to 0
+			floorDigits[0] = '0';
+			floorDigits[1] = '\0';
+
+			// Start the floor selection over again
+			floorIndex = 0;
 		}
-	}
 
-	if (index > 0)
+		write_to_lcd(entryTitle(), floorDigits);
+	}
+	else if (key_signal == 'A' || key_signal == 'B') // Hall call up / down
 	{
-		return atoi(floor); // convert collected digits to int
+		callType = (key_signal == 'A') ? CALL_HALL_UP : CALL_HALL_DOWN;
+		write_to_lcd(entryTitle(), floorDigits);
 	}
+	else if (key_signal == '*') // Cancel the entry
+	{
+		clearEntry();
+	}
+	else if (key_signal == 'C') // Door close
+	{
+		event_post(EVT_DOOR_CLOSE, 0);
+	}
+	else if (key_signal == 'D') // Door reopen
+	{
+		event_post(EVT_DOOR_REOPEN, 0);
+	}
+	else if (key_signal == '#') // '#' used to confirm entry of floor
+	{
+		int selected = 0; // invalid or no input
 
-	return 0; // invalid or no input
+		if (floorIndex > 0)
+		{
+			selected = atoi(floorDigits); // convert collected digits to int
+		}
+
+		if (selected < FLOOR_COUNT)
+		{
+			event_post(EVT_KEY_CONFIRMED, callType | selected);
+		}
+		else
+		{
+			write_to_lcd("Invalid floor", floorDigits);
+		}
+
+		// Clear the buffer for the next entry
+		clearEntry();
+	}
 }
@@ -13,10 +13,14 @@
 #include "keypad.h"
 #include <stdlib.h>
 
+#define KEYPAD_NO_KEY 'z'		 // Returned by KEYPAD_ReadKey() when nothing is pressed
+#define KEYPAD_SCAN_PERIOD_MS 10 // keypad_task() period
+#define KEYPAD_DEBOUNCE_SCANS 2	 // Extra identical scans before a key counts
+
 /**
  * @brief Handles keypad input and updates the LCD with the key pressed.
  */
-int handleEmergencyKey(void);
-int handle_keypad_input(void);
+void keypad_task(void);
+void handle_keypad_input(uint8_t key_signal);
 
 #endif // KEYPAD_HANDLER_H
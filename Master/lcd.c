@@ -27,6 +27,7 @@
 #include <avr/pgmspace.h>
 #include <util/delay.h>
 #include "lcd.h"
+#include "prof.h"
 
 
 
@@ -270,6 +271,8 @@ static uint8_t lcd_waitbusy(void)
 {
     register uint8_t c;
     
+    PROF_ENTER(PROF_LCD_WAITBUSY);
+
     /* wait until busy flag is cleared */
     while ( (c=lcd_read(0)) & (1<<LCD_BUSY)) {}
     
@@ -277,7 +280,9 @@ static uint8_t lcd_waitbusy(void)
     delay(LCD_DELAY_BUSY_FLAG);
 
     /* now read the address counter */
-    return (lcd_read(0));  // return address counter
+    c = lcd_read(0);
+    PROF_EXIT(PROF_LCD_WAITBUSY);
+    return (c);  // return address counter
     
 }/* lcd_waitbusy */
 
@@ -422,6 +427,7 @@ void lcd_putc(char c)
     uint8_t pos;
 
 
+    PROF_ENTER(PROF_LCD_PUTC);
     pos = lcd_waitbusy();   // read busy-flag and address counter
     if (c=='\n')
     {
@@ -455,6 +461,7 @@ void lcd_putc(char c)
 #endif
         lcd_write(c, 1);
     }
+    PROF_EXIT(PROF_LCD_PUTC);
 
 }/* lcd_putc */
 
@@ -493,21 +500,12 @@ void lcd_puts_p(const char *progmem_s)
 }/* lcd_puts_p */
 
 
+#if LCD_IO_MODE
 /*************************************************************************
-Initialize display and select type of cursor 
-Input:    dispAttr LCD_DISP_OFF            display off
-                   LCD_DISP_ON             display on, cursor off
-                   LCD_DISP_ON_CURSOR      display on, cursor on
-                   LCD_DISP_CURSOR_BLINK   display on, cursor on flashing
-Returns:  none
+Configure the LCD data and control lines as outputs
 *************************************************************************/
-void lcd_init(uint8_t dispAttr)
+static void lcd_init_ports(void)
 {
-#if LCD_IO_MODE
-    /*
-     *  Initialize LCD to 4 bit I/O mode
-     */
-     
     if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
       && ( &LCD_RS_PORT == &LCD_DATA0_PORT) && ( &LCD_RW_PORT == &LCD_DATA0_PORT) && (&LCD_E_PORT == &LCD_DATA0_PORT)
       && (LCD_DATA0_PIN == 0 ) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) 
@@ -536,6 +534,26 @@ void lcd_init(uint8_t dispAttr)
         DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
         DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
     }
+}/* lcd_init_ports */
+#endif
+
+
+/*************************************************************************
+Initialize display and select type of cursor 
+Input:    dispAttr LCD_DISP_OFF            display off
+                   LCD_DISP_ON             display on, cursor off
+                   LCD_DISP_ON_CURSOR      display on, cursor on
+                   LCD_DISP_CURSOR_BLINK   display on, cursor on flashing
+Returns:  none
+*************************************************************************/
+void lcd_init(uint8_t dispAttr)
+{
+#if LCD_IO_MODE
+    /*
+     *  Initialize LCD to 4 bit I/O mode
+     */
+     
+    lcd_init_ports();
     delay(LCD_DELAY_BOOTUP);             /* wait 16ms or more after power-on       */
     
     /* initial write to lcd is 8bit */
@@ -590,3 +608,59 @@ void lcd_init(uint8_t dispAttr)
     lcd_command(dispAttr);                  /* display/cursor control       */
 
 }/* lcd_init */
+
+
+#if LCD_IO_MODE
+/*************************************************************************
+Initialize display without blocking through the power-on delays.
+Call repeatedly: each call performs the next step of the lcd_init()
+sequence and returns the time in microseconds to wait before the next
+call, 0 once the display is initialized.
+Input:    dispAttr as for lcd_init()
+Returns:  microseconds until the next step, 0 when done
+*************************************************************************/
+uint16_t lcd_init_step(uint8_t dispAttr)
+{
+    static uint8_t step = 0;
+
+    switch (step++)
+    {
+    case 0:
+        lcd_init_ports();
+        return LCD_DELAY_BOOTUP;             /* wait 16ms or more after power-on       */
+    case 1:
+        /* initial write to lcd is 8bit */
+        LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);    // LCD_FUNCTION>>4;
+        LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);    // LCD_FUNCTION_8BIT>>4;
+        lcd_e_toggle();
+        return LCD_DELAY_INIT;               /* busy flag can't be checked here */
+    case 2:
+    case 3:
+        /* repeat last command twice */
+        lcd_e_toggle();
+        return LCD_DELAY_INIT_REP;
+    case 4:
+        /* now configure for 4bit mode */
+        LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);   // LCD_FUNCTION_4BIT_1LINE>>4
+        lcd_e_toggle();
+        return LCD_DELAY_INIT_4BIT;
+    default:
+        break;
+    }
+
+    /* from now the LCD only accepts 4 bit I/O, we can use lcd_command() */
+#if KS0073_4LINES_MODE
+    lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
+    lcd_command(KS0073_4LINES_MODE);
+    lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
+#else
+    lcd_command(LCD_FUNCTION_DEFAULT);      /* function set: display lines  */
+#endif
+    lcd_command(LCD_DISP_OFF);              /* display off                  */
+    lcd_clrscr();                           /* display clear                */
+    lcd_command(LCD_MODE_DEFAULT);          /* set entry mode               */
+    lcd_command(dispAttr);                  /* display/cursor control       */
+    step = 0;
+    return 0;
+}/* lcd_init_step */
+#endif
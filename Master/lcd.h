@@ -292,6 +292,17 @@
 extern void lcd_init(uint8_t dispAttr);
 
 
+/**
+ @brief    Initialize display one step at a time, without waiting
+ 
+ Runs the lcd_init() sequence step by step so other initialization can
+ overlap the power-on delays. Call until it returns 0.
+ @param    dispAttr as for lcd_init()
+ @return   microseconds to wait before the next call, 0 when initialized
+*/
+extern uint16_t lcd_init_step(uint8_t dispAttr);
+
+
 /**
  @brief    Clear display and set cursor to home position
  @return   none
@@ -6,23 +6,78 @@
  */
 
 #include "lcd_handler.h"
+#include "timer.h"
+
+static char lcdLines[LCD_LINES][LCD_DISP_LENGTH + 1]; // What the display should show
+static bool lcdDirty = false;						  // lcdLines changed since the last refresh
 
 // These functions are based on LUT Inroduction To Embeded Systems course Exercise 3 example solution
-void lcd_setup()
+// Runs the next step of the LCD power-on sequence once its delay is over and
+// returns true when the display is ready. Boot calls it between the other
+// init work instead of sleeping through the delays.
+bool lcd_setup_step(void)
+{
+	static uint32_t nextStep = 0; // timer_micros() of the next step
+	static bool ready = false;
+	uint16_t wait;
+
+	if (ready)
+	{
+		return true;
+	}
+	if ((int32_t)(timer_micros() - nextStep) < 0)
+	{
+		return false;
+	}
+
+	wait = lcd_init_step(LCD_DISP_ON); // Display on, cursor off
+	if (wait == 0)
+	{
+		ready = true;
+		lcd_puts("Ready"); // Display the message "Ready" on the LCD
+		return true;
+	}
+	nextStep = timer_micros() + wait;
+	return false;
+}
+
+// Copy a line into the frame buffer padded with spaces, so a refresh
+// overwrites the old text without a slow lcd_clrscr()
+static void set_line(uint8_t line, const char *text)
 {
-	lcd_init(LCD_DISP_ON); // Initialize LCD with display on, cursor off
-	lcd_clrscr();		   // Clear the LCD screen
-	lcd_puts("Ready");	   // Display the message "Ready" on the LCD
-	_delay_ms(1000);	   // Wait for 1 second to allow the user to see the message
-	KEYPAD_Init();		   // Initialize the keypad for user input
+	uint8_t i = 0;
+
+	while ((i < LCD_DISP_LENGTH) && (text[i] != '\0'))
+	{
+		lcdLines[line][i] = text[i];
+		i++;
+	}
+	while (i < LCD_DISP_LENGTH)
+	{
+		lcdLines[line][i++] = ' ';
+	}
+	lcdLines[line][LCD_DISP_LENGTH] = '\0';
 }
 
-// This
+// Only updates the frame buffer, lcd_task() does the actual drawing
 void write_to_lcd(const char *line1, const char *line2)
 {
-	lcd_clrscr();	  // Clear the LCD screen before writing new content
-	lcd_gotoxy(0, 0); // Set cursor to the beginning of the first line
-	lcd_puts(line1);  // Display the first line of text
-	lcd_gotoxy(0, 1); // Set cursor to the beginning of the second line
-	lcd_puts(line2);  // Display the second line of text
-}
\ No newline at end of file
+	set_line(0, line1); // First line of text
+	set_line(1, line2); // Second line of text
+	lcdDirty = true;
+}
+
+// Redraws the display when the frame buffer has changed
+void lcd_task(void)
+{
+	if (!lcdDirty)
+	{
+		return;
+	}
+	lcdDirty = false;
+
+	lcd_gotoxy(0, 0);		// Set cursor to the beginning of the first line
+	lcd_puts(lcdLines[0]); // Display the first line of text
+	lcd_gotoxy(0, 1);		// Set cursor to the beginning of the second line
+	lcd_puts(lcdLines[1]); // Display the second line of text
+}
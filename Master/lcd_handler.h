@@ -12,9 +12,11 @@
 #include <util/delay.h>
 #include "lcd.h" // lcd header file made by Peter Fleury
 #include "keypad.h"
+#include <stdbool.h>
 
-void lcd_setup(void);
+bool lcd_setup_step(void); // True once the display is initialized
 
 void write_to_lcd(const char *line1, const char *line2);
+void lcd_task(void);
 
 #endif
@@ -14,33 +14,54 @@
 #define FOSC 16000000UL
 #define BAUD 9600
 #define MYUBBR (FOSC / 16 / BAUD - 1) // baud rate register value
-#define SLAVE_ADDRESS 0b1010111		  // 87 as decimal
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 #include <util/setbaud.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 // These include functions to handle lcd and keypad
 #include "lcd_handler.h"
 #include "keypad_handler.h"
-
-// Elevator FSM states
-typedef enum
+#include "timer.h"
+#include "scheduler.h"
+#include "emergency.h"
+#include "elevator.h"
+#include "slave_comm.h"
+#include "motion.h"
+#include "door.h"
+#include "demand.h"
+#include "traffic.h"
+#include "checkpoint.h"
+#include "eventlog.h"
+#include "stats.h"
+#include "console.h"
+#include "params.h"
+#include "stack.h"
+#include "prof.h"
+#include "idle.h"
+
+#define LCD_REFRESH_PERIOD_MS 50 // How often lcd_task() may redraw the display
+#define WATCHDOG_TIMEOUT WDTO_1S // Longest a single scheduler pass may take
+#define BOOT_STAGE_COUNT 5
+
+// Reset cause, saved before main() clears it
+uint8_t mcusr_mirror __attribute__((section(".noinit")));
+
+// The watchdog stays enabled after a watchdog reset, turn it off before the
+// slow init in main() can trip it again
+void get_mcusr(void) __attribute__((naked)) __attribute__((section(".init3")));
+void get_mcusr(void)
 {
-	IDLE,
-	FLOOR_SELECTED,
-	MOVING,
-	FAULT,
-	DOOR_OPEN
-} ElevatorState;
-
-ElevatorState state = IDLE; //Setting elevator state to IDLE
-
-// Track current and selected floor
-uint8_t currentFloor = 1;
-uint8_t selectedFloor = 1;
+	mcusr_mirror = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+}
 
 // USART init for debugging via serial
 static void USART_init(uint16_t ubrr)
@@ -65,178 +86,149 @@ static void USART_Transmit(unsigned char data, FILE *stream)
 	UDR0 = data;
 }
 
-// USART receive helper
-static char USART_Receive(FILE *stream)
-{
-	/* Wait until the transmit buffer is empty*/
-	while (!(UCSR0A & (1 << RXC0)))
-	{
-		;
-	}
-
-	/* Get the received data from the buffer */
-	return UDR0;
-}
-
 FILE uart_output = FDEV_SETUP_STREAM(USART_Transmit, NULL, _FDEV_SETUP_WRITE); //Creating a file object uart_output
-FILE uart_input = FDEV_SETUP_STREAM(NULL, USART_Receive, _FDEV_SETUP_READ);  //Creating a file object uart_input
 
-// Sends 1 byte command to the slave over I2C
-void sendCommandToSlave(uint8_t command)
+// Boot pipeline: each stage initializes a peripheral and runs a quick
+// self-test, the LCD power-on sequence is stepped in between
+typedef struct
 {
-	TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN); // Send START
-	while (!(TWCR & (1 << TWINT))) //Waiting for START condition to transmit (when TWINT becomes 1)
-	{
-		;
-	}
+	PGM_P name;
+	bool (*run)(void); // Returns false if the self-test failed
+} BootStage;
 
-	TWDR = (SLAVE_ADDRESS << 1); // SLA+W   Left shifting slave address for R/W bit
-	TWCR = (1 << TWINT) | (1 << TWEN); //Send address 
-	while (!(TWCR & (1 << TWINT))) //Wait for the end of transmission
-	{
-		;
-	}
+static bool boot_usart(void)
+{
+	USART_init(MYUBBR); // initialize USART with 9600 Baud
+	stdout = &uart_output; // redirect stdout to UART function, input goes to the console
+	console_init();
+	return (UCSR0A & (1 << UDRE0)) != 0; // Transmitter ready
+}
 
-	TWDR = command; // Send command byte
-	TWCR = (1 << TWINT) | (1 << TWEN); //Send address 
-	while (!(TWCR & (1 << TWINT))) //Wait for the end of transmission
+static bool boot_twi(void)
+{
+	twi_init(); // Initialize TWI/I²C
+	slave_attention_init();
+	if (!twi_bus_idle())
 	{
-		;
+		twi_recover(); // A Slave reset mid-byte can still hold SDA low
 	}
-
-	TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO); // Send STOP
+	return twi_bus_idle(); // Nothing holds SCL or SDA low
 }
 
-void displayFloorMessage(const char *format, int floorNumber, const char *doorOpen) //Display floor and status
+static bool boot_keypad(void)
 {
-    char message[50]; //Define a string
-    sprintf(message, format, floorNumber); //Format a string with sprintf
-    write_to_lcd(message, doorOpen); //Writing floor and status on screen
+	KEYPAD_Init(); // Initialize the keypad for user input
+	return KEYPAD_ReadKey() == KEYPAD_NO_KEY; // No key stuck down
 }
 
-void handleEmergency(int currentFloor, char *doorOpen) //Create a emergency handling state function
+static bool boot_slaves(void)
 {
-    uint8_t escape = 0; //Initializing variable to 0
-
-    displayFloorMessage("EMERGENCY %d", currentFloor, doorOpen); //Show emergency message
-    sendCommandToSlave(0x03);// Blink movement LED = FAULT
-    while (1) //Enter loop
-    {
-        escape = handleEmergencyKey(); //Emergency key handling
-        if (escape == 1) //If emergency key is pressed
-        {
-            strcpy(doorOpen, "Door open"); //Open door
-			displayFloorMessage("EMERGENCY %d", currentFloor, doorOpen); //Display message of emergency
-			sendCommandToSlave(0x06);// Play buzzer melody
-			strcpy(doorOpen, "Door closed"); //Close door
-            state = IDLE; //Set state to IDLE
-            break;
-        }
-    }
-}
+	bool ok = true;
 
-int main(void)
-{   
-    lcd_clrscr();
-	USART_init(MYUBBR); // initialize USART with 9600 Baud
-	lcd_setup();		// initialize lcd
+	for (uint8_t car = 0; car < CAR_COUNT; car++)
+	{
+		ok &= slave_probe(car);
+	}
+	return ok;
+}
 
-	stdout = &uart_output; // redirect stdin/out to UART function
-	stdin = &uart_input;
+static bool boot_storage(void)
+{
+	params_init(); // Timing parameters, also sent to the Slaves
+	demand_init(); // Call histogram from EEPROM
+	traffic_init();
+	stats_init();
+	elevator_init(); // Resumes from the EEPROM checkpoint
+	eventlog_init();
+	return true;
+}
 
-	// Initialize TWI/I²C
-	TWBR = 0x03; // TWI bit rate register.
-	TWSR = 0x00; // TWI status register prescaler value set to 1
+static const char bootUsart[] PROGMEM = "USART";
+static const char bootTwi[] PROGMEM = "TWI bus";
+static const char bootKeypad[] PROGMEM = "Keypad";
+static const char bootSlaves[] PROGMEM = "Slaves";
+static const char bootStorage[] PROGMEM = "EEPROM";
 
-	TWCR |= (1 << TWEN); // Set to enable the TWI
+static const BootStage bootStages[BOOT_STAGE_COUNT] PROGMEM = {
+	{bootUsart, boot_usart},
+	{bootTwi, boot_twi},
+	{bootKeypad, boot_keypad},
+	{bootSlaves, boot_slaves},
+	{bootStorage, boot_storage},
+};
 
-	DDRA &= ~(1 << PA0); // Emergency button input
-	uint8_t emergency_button = 0; //Initializing
-    char message[50]; //Setting up door closing message
-    char doorOpen[15] = "Door closed"; //Creating door closing message
-    
-	while (1) //Creating a loop
+int main(void)
+{
+	uint32_t bootStart;
+	uint32_t bootTime;
+	uint8_t failed = 0; // One bit per boot stage
+	BootStage stage;
+
+	emergency_init(); // Emergency button input, sampled by the timer ISR
+	timer_init(); // 1 ms system tick, also times the boot
+	idle_init(); // Unused peripherals off
+#if PROFILE
+	prof_init(); // Timer5 cycle counter
+#endif
+	sched_init();
+	sei();
+	bootStart = timer_micros();
+
+	// Run the boot stages while the LCD waits through its power-on delays
+	for (uint8_t i = 0; !lcd_setup_step() || (i < BOOT_STAGE_COUNT);)
 	{
-
-
-		switch (state) //Create states for elevator
+		if (i < BOOT_STAGE_COUNT)
 		{
-		case IDLE:  //IDLE state waits for input and displays floor
-            displayFloorMessage("Floor %d", currentFloor, doorOpen); //Display floor
-			selectedFloor = handle_keypad_input(); // Updates keypad buffer
-            printf("Floornumber"); // Debuggin test prints
-            printf("%d\n",selectedFloor); //Display selected floor
-			if (selectedFloor >= 0 && selectedFloor <= 99) //If selected floor number is valid
+			memcpy_P(&stage, &bootStages[i], sizeof(stage));
+			if (!stage.run())
 			{
-				state = FLOOR_SELECTED; //set state to FLOOR_SELECTED
+				failed |= 1 << i;
 			}
-			break;
-
-        case FLOOR_SELECTED: //When floor is selected
-        if (selectedFloor == currentFloor) //If selected floor is the same as current floor
-        {
-            sendCommandToSlave(0x03); // Blink movement LED = FAULT
-            displayFloorMessage("Already on %d", currentFloor, doorOpen); //Display message
-            _delay_ms(2000); //Wait for 2 seconds
-            state = DOOR_OPEN; //Open door
-        }
-        else //Move the elevator to selected floor
-        {
-            sendCommandToSlave(0x01); // Turn on movement LED
-            displayFloorMessage("Moving to %d", selectedFloor, doorOpen); //Display message of moving
-           
-            _delay_ms(3000); // Simulate movement delay
-
-            while (1) //Simulate elevator moving
-            {
-
-                displayFloorMessage("Current floor %d", currentFloor, doorOpen); //Display floor number of passed floors
-                _delay_ms(150); //Delay of 150 ms 
-
-                if (currentFloor < selectedFloor) //If below selected floor
-                {
-                    currentFloor++; // Elevator goes up
-                }
-                else if (currentFloor > selectedFloor) //If above selected floor
-                {
-                    currentFloor--; //Elevator goes down
-                }
-                else if (currentFloor == selectedFloor) //If floor is correct
-                {
-					sendCommandToSlave(0x02); // Turn off movement LED
-					displayFloorMessage("Arrived on %d", currentFloor, doorOpen); // Display message of arrival
-					_delay_ms(500); // Delay of half a second
-					state = DOOR_OPEN; //Open doors
-                    break;
-                }
-                emergency_button = (PINA & (1 << PA0)); // Emergency check
-                if (emergency_button) //If emergency button is pressed
-                {   
-                    handleEmergency(currentFloor, doorOpen); //Call emergency handling function
-					_delay_ms(5000); //Wait for 5 seconds
-					state = IDLE; //Set state to IDLE
-                    break;
-                }
-
-            }  
-        }
-        break;
-
-		case DOOR_OPEN: // Door-opening sequence
-			_delay_ms(100); // wait for 0,1 seconds
-            strcpy(doorOpen,"Door open"); // Copy door opening message to string
-            displayFloorMessage("Arrived on %d", currentFloor, doorOpen); // DIsplay message of arrival
-			sendCommandToSlave(0x04); // Open door LED
-			_delay_ms(5000);		  // Hold door open
-			sendCommandToSlave(0x05); // Close door LED
-            strcpy(doorOpen, "Door closed"); //Copy door closing message to string
-			state = IDLE; // Set state to IDLE
-			break;
-
-		default:
-			state = IDLE; // Set state to IDLE
+			i++;
+		}
+	}
+
+	sched_add_task(keypad_task, KEYPAD_SCAN_PERIOD_MS);
+	sched_add_task(elevator_task, 0);
+	sched_add_task(elevator_motion_task, MOTION_TICK_MS);
+	sched_add_task(elevator_door_task, DOOR_TICK_MS);
+	sched_add_task(slave_task, 0);
+	sched_add_task(lcd_task, LCD_REFRESH_PERIOD_MS);
+	sched_add_task(demand_task, 0);
+	sched_add_task(checkpoint_task, 0);
+	sched_add_task(eventlog_task, 0);
+	sched_add_task(console_task, 0);
+	sched_add_task(stats_task, 0);
+	sched_add_task(stack_task, STACK_CHECK_MS);
+#if PROFILE
+	sched_add_task(prof_task, 0);
+#endif
+
+	eventlog_write(LOG_BOOT, 0, mcusr_mirror, 0);
+	wdt_enable(WATCHDOG_TIMEOUT); // A task stuck in a busy loop (TWI, keypad) resets the Master
+	bootTime = timer_micros() - bootStart; // Serviceable from here on
+
+	// Reporting over the 9600 baud UART is slow, so it comes after the measurement
+	printf("Boot to ready %lu us\n", bootTime);
+	if (mcusr_mirror & (1 << WDRF))
+	{
+		printf("Watchdog reset\n");
+	}
+	elevator_resume_report();
+	for (uint8_t i = 0; i < BOOT_STAGE_COUNT; i++)
+	{
+		if (failed & (1 << i))
+		{
+			printf_P(PSTR("Self-test failed: %S\n"), (PGM_P)pgm_read_word(&bootStages[i].name));
 		}
 	}
 
+	while (1) //Creating a loop
+	{
+		sched_run_once(); // Run every task that is due
+		wdt_reset();
+		idle_sleep(); // Until the next interrupt, the 1 ms tick at the latest
+	}
+
 	return 0;
 }
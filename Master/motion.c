@@ -0,0 +1,243 @@
+/*
+ * motion.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "motion.h"
+#include <math.h>
+
+#define MOTION_MIN_SPEED 50 // mm/s, creep speed for the last millimetres
+
+MotionProfile motionProfile = {
+	.accel = 800,
+	.speed = 1500,
+	.decel = 800,
+	.floorHeight = 3000,
+	.levelTime = 500,
+	.startDelay = 500,
+};
+
+static inline uint32_t floor_position(uint8_t floor)
+{
+	return (uint32_t)floor * motionProfile.floorHeight;
+}
+
+static inline uint32_t distance_left(const Motion *m)
+{
+	return m->up ? (m->target - m->position) : (m->position - m->target);
+}
+
+// Distance needed to brake from speed to standstill
+static inline uint32_t stopping_distance(uint16_t speed)
+{
+	return ((uint32_t)speed * speed) / (2UL * motionProfile.decel);
+}
+
+// Time in seconds to cover distance starting at speed v0 and ending at rest
+static float travel_time(float distance, float v0)
+{
+	float a = motionProfile.accel;
+	float b = motionProfile.decel;
+	float vmax = motionProfile.speed;
+	float dAccel = (vmax * vmax - v0 * v0) / (2.0f * a);
+	float dDecel = (vmax * vmax) / (2.0f * b);
+
+	if (distance <= 0.0f)
+	{
+		return 0.0f;
+	}
+
+	if (distance >= dAccel + dDecel)
+	{
+		// Trapezoid: accelerate, cruise, brake
+		return (vmax - v0) / a + vmax / b + (distance - dAccel - dDecel) / vmax;
+	}
+
+	// Triangle: peak speed never reaches the cruise speed
+	float peak = sqrtf((2.0f * a * b * distance + b * v0 * v0) / (a + b));
+
+	if (peak < v0)
+	{
+		return 2.0f * distance / v0; // Already braking
+	}
+	return (peak - v0) / a + peak / b;
+}
+
+void motion_init(Motion *m, uint8_t floor)
+{
+	m->position = floor_position(floor);
+	m->target = m->position;
+	m->speed = 0;
+	m->remainder = 0;
+	m->levelLeft = 0;
+	m->up = true;
+	m->phase = MOTION_STOPPED;
+}
+
+bool motion_start(Motion *m, uint8_t floor)
+{
+	uint32_t target = floor_position(floor);
+
+	if (target == m->position)
+	{
+		return false;
+	}
+
+	m->target = target;
+	m->up = (target > m->position);
+	m->speed = 0;
+	m->remainder = 0;
+	m->phase = MOTION_ACCEL;
+	return true;
+}
+
+bool motion_retarget(Motion *m, uint8_t floor)
+{
+	uint32_t target = floor_position(floor);
+
+	if (!motion_moving(m) || (m->phase == MOTION_LEVELING))
+	{
+		return false;
+	}
+	if (m->up ? (target <= m->position) : (target >= m->position))
+	{
+		return false; // Behind the car
+	}
+	if ((m->up ? (target - m->position) : (m->position - target)) < stopping_distance(m->speed))
+	{
+		return false; // Too close to brake for
+	}
+
+	m->target = target;
+	if (m->phase == MOTION_DECEL)
+	{
+		m->phase = MOTION_ACCEL; // Further away than the old target, speed up again
+	}
+	return true;
+}
+
+bool motion_step(Motion *m, uint16_t dt_ms)
+{
+	uint32_t left;
+	uint32_t travel;
+	uint16_t dv;
+
+	switch (m->phase)
+	{
+	case MOTION_STOPPED:
+		return false;
+
+	case MOTION_LEVELING:
+		if (m->levelLeft > dt_ms)
+		{
+			m->levelLeft -= dt_ms;
+			return false;
+		}
+		m->levelLeft = 0;
+		m->phase = MOTION_STOPPED;
+		return true;
+
+	default:
+		break;
+	}
+
+	left = distance_left(m);
+
+	// Brake once the remaining distance is what it takes to stop from this speed
+	if (left <= stopping_distance(m->speed) + ((uint32_t)m->speed * dt_ms) / 1000UL)
+	{
+		m->phase = MOTION_DECEL;
+	}
+
+	if (m->phase == MOTION_DECEL)
+	{
+		dv = (uint16_t)(((uint32_t)motionProfile.decel * dt_ms) / 1000UL);
+		m->speed = (m->speed > dv + MOTION_MIN_SPEED) ? (m->speed - dv) : MOTION_MIN_SPEED;
+	}
+	else
+	{
+		dv = (uint16_t)(((uint32_t)motionProfile.accel * dt_ms) / 1000UL);
+		if (m->speed + dv >= motionProfile.speed)
+		{
+			m->speed = motionProfile.speed;
+			m->phase = MOTION_CRUISE;
+		}
+		else
+		{
+			m->speed += dv;
+		}
+	}
+
+	travel = (uint32_t)m->speed * dt_ms + m->remainder;
+	m->remainder = travel % 1000UL;
+	travel /= 1000UL;
+
+	if (travel >= left)
+	{
+		// At the landing, hold for levelling
+		m->position = m->target;
+		m->speed = 0;
+		m->remainder = 0;
+		m->levelLeft = motionProfile.levelTime;
+		m->phase = MOTION_LEVELING;
+		return false;
+	}
+
+	m->position = m->up ? (m->position + travel) : (m->position - travel);
+	return false;
+}
+
+bool motion_moving(const Motion *m)
+{
+	return m->phase != MOTION_STOPPED;
+}
+
+uint8_t motion_floor(const Motion *m)
+{
+	return (uint8_t)((m->position + motionProfile.floorHeight / 2) / motionProfile.floorHeight);
+}
+
+uint8_t motion_stop_floor(const Motion *m)
+{
+	uint32_t height = motionProfile.floorHeight;
+	uint32_t stop = stopping_distance(m->speed);
+
+	if (!motion_moving(m) || (m->phase == MOTION_LEVELING))
+	{
+		return motion_floor(m);
+	}
+	if (m->up)
+	{
+		return (uint8_t)((m->position + stop + height - 1) / height); // Round up
+	}
+	if (stop >= m->position)
+	{
+		return 0;
+	}
+	return (uint8_t)((m->position - stop) / height); // Round down
+}
+
+uint32_t motion_eta_ms(const Motion *m)
+{
+	float seconds;
+
+	if (!motion_moving(m))
+	{
+		return 0;
+	}
+	if (m->phase == MOTION_LEVELING)
+	{
+		return m->levelLeft;
+	}
+
+	seconds = travel_time((float)distance_left(m), (float)m->speed);
+	return (uint32_t)(seconds * 1000.0f) + motionProfile.levelTime;
+}
+
+uint32_t motion_trip_time_ms(uint8_t floors)
+{
+	float seconds = travel_time((float)floor_position(floors), 0.0f);
+
+	return (uint32_t)(seconds * 1000.0f) + motionProfile.levelTime + motionProfile.startDelay;
+}
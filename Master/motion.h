@@ -0,0 +1,79 @@
+/*
+ * motion.h
+ *
+ * Created: 16.10.2026
+ *
+ * Kinematic model of the car: trapezoidal speed profile with separate
+ * acceleration and deceleration, a cruise speed limit and a levelling
+ * period at the landing. motion_step() integrates the profile in fixed
+ * ticks, the estimate functions give closed form travel times.
+ */
+
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MOTION_TICK_MS 10 // motion_step() period
+
+typedef struct
+{
+	uint16_t accel;		  // mm/s^2
+	uint16_t speed;		  // Cruise speed, mm/s
+	uint16_t decel;		  // mm/s^2
+	uint16_t floorHeight; // mm between landings
+	uint16_t levelTime;	  // ms spent levelling at the landing
+	uint16_t startDelay;  // ms from the trip decision to motor start (brake lift)
+} MotionProfile;
+
+typedef enum
+{
+	MOTION_STOPPED,
+	MOTION_ACCEL,
+	MOTION_CRUISE,
+	MOTION_DECEL,
+	MOTION_LEVELING
+} MotionPhase;
+
+typedef struct
+{
+	uint32_t position;	// mm above floor 0
+	uint32_t target;	// mm above floor 0
+	uint16_t speed;		// mm/s, always >= 0, direction is in up
+	uint16_t remainder; // Travel below 1 mm carried to the next tick, mm*ms/s
+	uint16_t levelLeft; // ms of levelling left
+	bool up;
+	MotionPhase phase;
+} Motion;
+
+extern MotionProfile motionProfile;
+
+void motion_init(Motion *m, uint8_t floor);
+
+// Start a trip from rest. Returns false if already there.
+bool motion_start(Motion *m, uint8_t floor);
+
+// Change the destination while moving. Fails if the car cannot stop there
+// with the configured deceleration or the floor is behind the car.
+bool motion_retarget(Motion *m, uint8_t floor);
+
+// Advance the model by dt_ms. Returns true on the tick the car has levelled
+// at its target.
+bool motion_step(Motion *m, uint16_t dt_ms);
+
+bool motion_moving(const Motion *m);
+
+// Landing the car is closest to
+uint8_t motion_floor(const Motion *m);
+
+// First landing ahead of the car it can still stop at
+uint8_t motion_stop_floor(const Motion *m);
+
+// Estimated time to finish the current trip, levelling included
+uint32_t motion_eta_ms(const Motion *m);
+
+// Estimated time of a trip of floors landings from rest, start delay and levelling included
+uint32_t motion_trip_time_ms(uint8_t floors);
+
+#endif // MOTION_H
@@ -0,0 +1,187 @@
+/*
+ * params.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "params.h"
+#include "eeprom_map.h"
+#include "eventlog.h"
+#include "slave_comm.h"
+#include "door.h"
+#include "motion.h"
+#include "elevator.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <stddef.h>
+#include <string.h>
+
+#define PARAMS_VERSION 1 // Bump when a parameter is added or its meaning changes
+
+typedef struct
+{
+	PGM_P name;
+	uint16_t def;
+	uint16_t min;
+	uint16_t max;
+	uint8_t slave; // PROTO_PARAM_* to forward to, PROTO_PARAM_NONE if Master only
+} ParamInfo;
+
+typedef struct
+{
+	uint8_t version;
+	uint8_t count;
+	uint16_t values[PARAM_COUNT];
+	uint8_t crc; // CRC-8 of everything above
+} ParamBlock;
+
+_Static_assert(sizeof(ParamBlock) <= EEPROM_DEMAND_START - EEPROM_PARAMS_START, "Parameter block does not fit");
+
+static const char nameDwellHall[] PROGMEM = "dwell_hall";
+static const char nameDwellCar[] PROGMEM = "dwell_car";
+static const char nameDwellMin[] PROGMEM = "dwell_min";
+static const char nameObstruction[] PROGMEM = "obstruction";
+static const char nameDoorClose[] PROGMEM = "door_close";
+static const char nameAlreadyOn[] PROGMEM = "already_on";
+static const char nameRecover[] PROGMEM = "recover";
+static const char nameParkDelay[] PROGMEM = "park_delay";
+static const char nameParkPeak[] PROGMEM = "park_peak";
+static const char nameStartDelay[] PROGMEM = "start_delay";
+static const char nameLevelTime[] PROGMEM = "level_time";
+static const char nameSpeed[] PROGMEM = "speed";
+static const char nameAccel[] PROGMEM = "accel";
+static const char nameDecel[] PROGMEM = "decel";
+static const char nameFloorHeight[] PROGMEM = "floor_height";
+static const char nameSlaveBlink[] PROGMEM = "blink";
+static const char nameSlaveNote[] PROGMEM = "note";
+static const char nameSlaveHold[] PROGMEM = "emergency_hold";
+
+static const ParamInfo paramInfo[PARAM_COUNT] PROGMEM = {
+	[PARAM_DWELL_HALL] = {nameDwellHall, DOOR_DWELL_HALL_MS, 500, 30000, PROTO_PARAM_NONE},
+	[PARAM_DWELL_CAR] = {nameDwellCar, DOOR_DWELL_CAR_MS, 500, 30000, PROTO_PARAM_NONE},
+	[PARAM_DWELL_MIN] = {nameDwellMin, DOOR_DWELL_MIN_MS, 0, 10000, PROTO_PARAM_NONE},
+	[PARAM_OBSTRUCTION] = {nameObstruction, DOOR_OBSTRUCTION_MS, 500, 10000, PROTO_PARAM_NONE},
+	[PARAM_DOOR_CLOSE] = {nameDoorClose, DOOR_CLOSE_MS, 100, 10000, PROTO_PARAM_NONE},
+	[PARAM_ALREADY_ON] = {nameAlreadyOn, 2000, 0, 10000, PROTO_PARAM_NONE},
+	[PARAM_RECOVER] = {nameRecover, 5000, 0, 60000, PROTO_PARAM_NONE},
+	[PARAM_PARK_DELAY] = {nameParkDelay, 30000, 1000, 60000, PROTO_PARAM_NONE},
+	[PARAM_PARK_PEAK] = {nameParkPeak, 5000, 1000, 60000, PROTO_PARAM_NONE},
+	[PARAM_START_DELAY] = {nameStartDelay, 500, 0, 10000, PROTO_PARAM_NONE},
+	[PARAM_LEVEL_TIME] = {nameLevelTime, 500, 0, 5000, PROTO_PARAM_NONE},
+	[PARAM_SPEED] = {nameSpeed, 1500, 100, 10000, PROTO_PARAM_NONE},
+	[PARAM_ACCEL] = {nameAccel, 800, 100, 5000, PROTO_PARAM_NONE},
+	[PARAM_DECEL] = {nameDecel, 800, 100, 5000, PROTO_PARAM_NONE},
+	[PARAM_FLOOR_HEIGHT] = {nameFloorHeight, 3000, 1000, 10000, PROTO_PARAM_NONE},
+	[PARAM_SLAVE_BLINK] = {nameSlaveBlink, 300, 50, 2000, PROTO_PARAM_BLINK},
+	[PARAM_SLAVE_NOTE] = {nameSlaveNote, 500, 50, 2000, PROTO_PARAM_NOTE},
+	[PARAM_SLAVE_HOLD] = {nameSlaveHold, 2000, 0, 10000, PROTO_PARAM_HOLD},
+};
+
+uint16_t paramCache[PARAM_COUNT];
+
+static uint8_t crc8(const ParamBlock *b)
+{
+	const uint8_t *p = (const uint8_t *)b;
+	uint8_t crc = 0;
+
+	for (uint8_t i = 0; i < offsetof(ParamBlock, crc); i++)
+	{
+		crc = _crc8_ccitt_update(crc, p[i]);
+	}
+	return crc;
+}
+
+static bool inRange(ParamId id, uint16_t value)
+{
+	return (value >= pgm_read_word(&paramInfo[id].min)) && (value <= pgm_read_word(&paramInfo[id].max));
+}
+
+// Copies the cached values to the modules that keep their own copy
+static void apply(void)
+{
+	motionProfile.startDelay = paramCache[PARAM_START_DELAY];
+	motionProfile.levelTime = paramCache[PARAM_LEVEL_TIME];
+	motionProfile.speed = paramCache[PARAM_SPEED];
+	motionProfile.accel = paramCache[PARAM_ACCEL];
+	motionProfile.decel = paramCache[PARAM_DECEL];
+	motionProfile.floorHeight = paramCache[PARAM_FLOOR_HEIGHT];
+}
+
+static void forward(ParamId id)
+{
+	uint8_t slave = pgm_read_byte(&paramInfo[id].slave);
+
+	if (slave == PROTO_PARAM_NONE)
+	{
+		return;
+	}
+	for (uint8_t car = 0; car < CAR_COUNT; car++)
+	{
+		sendParamToSlave(car, slave, paramCache[id]);
+	}
+}
+
+static void save(void)
+{
+	ParamBlock b;
+
+	b.version = PARAMS_VERSION;
+	b.count = PARAM_COUNT;
+	memcpy(b.values, paramCache, sizeof(b.values));
+	b.crc = crc8(&b);
+
+	eventlog_suspend(); // Shares the EEPROM with the log interrupt
+	eeprom_update_block(&b, EEPROM_ADDR(EEPROM_PARAMS_START), sizeof(b)); // Usually the value and the CRC, ~10 ms
+	eventlog_resume();
+}
+
+void params_init(void)
+{
+	ParamBlock b;
+	bool valid;
+
+	eeprom_read_block(&b, EEPROM_ADDR(EEPROM_PARAMS_START), sizeof(b));
+	valid = (b.version == PARAMS_VERSION) && (b.count == PARAM_COUNT) && (crc8(&b) == b.crc);
+
+	for (uint8_t id = 0; id < PARAM_COUNT; id++)
+	{
+		// Blank, older or damaged block: everything from the defaults
+		paramCache[id] = (valid && inRange(id, b.values[id])) ? b.values[id] : pgm_read_word(&paramInfo[id].def);
+		forward(id); // The Slaves may have been swapped or reflashed
+	}
+	apply();
+}
+
+bool params_set(ParamId id, uint16_t value)
+{
+	if ((id >= PARAM_COUNT) || !inRange(id, value))
+	{
+		return false;
+	}
+	if ((id == PARAM_FLOOR_HEIGHT) && !elevator_set_floor_height(value))
+	{
+		return false; // Car positions are in mm, they can only be rescaled at rest
+	}
+	paramCache[id] = value;
+	apply();
+	forward(id);
+	save();
+	return true;
+}
+
+ParamId params_find(const char *name)
+{
+	for (uint8_t id = 0; id < PARAM_COUNT; id++)
+	{
+		if (strcmp_P(name, (PGM_P)pgm_read_word(&paramInfo[id].name)) == 0)
+		{
+			return id;
+		}
+	}
+	return PARAM_NONE;
+}
+
+PGM_P params_name(ParamId id)
+{
+	return (PGM_P)pgm_read_word(&paramInfo[id].name);
+}
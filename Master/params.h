@@ -0,0 +1,65 @@
+/*
+ * params.h
+ *
+ * Created: 16.10.2026
+ *
+ * Timing parameters that can be tuned on site. The values live in a
+ * versioned, CRC-checked block in EEPROM and are cached in RAM at boot. A
+ * blank, foreign or damaged block falls back to the compiled-in defaults.
+ * params_set() takes effect immediately and is written back at once, the
+ * Slave parameters are also forwarded to every car's Slave.
+ */
+
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+
+// Add new parameters at the end and bump PARAMS_VERSION in params.c
+typedef enum
+{
+	PARAM_DWELL_HALL,	// ms the door stays open at a hall call
+	PARAM_DWELL_CAR,	// ms the door stays open at a car call
+	PARAM_DWELL_MIN,	// ms left after the close key
+	PARAM_OBSTRUCTION,	// ms of dwell after an obstruction clears
+	PARAM_DOOR_CLOSE,	// ms the door takes to close
+	PARAM_ALREADY_ON,	// ms "Already on" is shown
+	PARAM_RECOVER,		// ms hold after an acknowledged emergency
+	PARAM_PARK_DELAY,	// ms idle before parking
+	PARAM_PARK_PEAK,	// Same in the peak modes
+	PARAM_START_DELAY,	// ms brake lift before the motor starts
+	PARAM_LEVEL_TIME,	// ms levelling at the landing
+	PARAM_SPEED,		// Cruise speed, mm/s
+	PARAM_ACCEL,		// mm/s^2
+	PARAM_DECEL,		// mm/s^2
+	PARAM_FLOOR_HEIGHT, // mm between landings
+	PARAM_SLAVE_BLINK,	// ms per half period of the fault blink
+	PARAM_SLAVE_NOTE,	// ms per note of the emergency melody
+	PARAM_SLAVE_HOLD,	// ms the door LED stays on after the melody
+	PARAM_COUNT
+} ParamId;
+
+#define PARAM_NONE PARAM_COUNT
+
+extern uint16_t paramCache[PARAM_COUNT];
+
+static inline uint16_t param(ParamId id)
+{
+	return paramCache[id];
+}
+
+// Loads the EEPROM block and sends the Slave parameters to the cars
+void params_init(void);
+
+// Returns false if the value is outside the parameter's range, or for
+// PARAM_FLOOR_HEIGHT while a car is moving
+bool params_set(ParamId id, uint16_t value);
+
+// PARAM_NONE if there is no parameter by that name
+ParamId params_find(const char *name);
+
+PGM_P params_name(ParamId id);
+
+#endif // PARAMS_H
@@ -0,0 +1,120 @@
+/*
+ * prof.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "prof.h"
+
+#if PROFILE
+
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DUMP_IDLE 0xFF
+
+_Static_assert(PROF_COUNT <= 8, "One PORTL pin per region");
+
+ProfStats profStats[PROF_COUNT];
+volatile uint16_t profOverflows = 0;
+
+static uint16_t overhead = 0; // Cycles of one prof_now(), taken off every sample
+static uint8_t dumpLine = DUMP_IDLE;
+
+static const char regionLcdPutc[] PROGMEM = "lcd_putc";
+static const char regionLcdWaitbusy[] PROGMEM = "lcd_waitbusy";
+static const char regionKeypadScan[] PROGMEM = "keypad_ScanKey";
+static const char regionSlaveSend[] PROGMEM = "TWI write";
+static const char regionFsmStep[] PROGMEM = "FSM step";
+
+static PGM_P const regionNames[PROF_COUNT] PROGMEM = {
+	[PROF_LCD_PUTC] = regionLcdPutc,
+	[PROF_LCD_WAITBUSY] = regionLcdWaitbusy,
+	[PROF_KEYPAD_SCAN] = regionKeypadScan,
+	[PROF_SLAVE_SEND] = regionSlaveSend,
+	[PROF_FSM_STEP] = regionFsmStep,
+};
+
+ISR(TIMER5_OVF_vect)
+{
+	profOverflows++;
+}
+
+void prof_reset(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // PROF_SLAVE_SEND is updated from TWI_vect
+	{
+		memset(profStats, 0, sizeof(profStats));
+		for (uint8_t r = 0; r < PROF_COUNT; r++)
+		{
+			profStats[r].min = UINT32_MAX;
+		}
+	}
+}
+
+void prof_init(void)
+{
+	uint32_t first;
+
+	prof_reset();
+	TCCR5A = 0; // Normal mode, OC5x pins disconnected
+	TCCR5B = (1 << CS50); // clk/1
+	TIMSK5 = (1 << TOIE5);
+#if PROFILE_GPIO
+	DDRL |= (1 << PROF_COUNT) - 1;
+#endif
+
+	first = prof_now();
+	overhead = prof_now() - first;
+}
+
+void prof_exit(ProfRegion r, uint32_t stop)
+{
+	ProfStats *s = &profStats[r];
+	uint32_t cycles = stop - s->start;
+
+#if PROFILE_GPIO
+	PORTL &= ~(1 << r);
+#endif
+	cycles = (cycles > overhead) ? (cycles - overhead) : 0;
+	s->count++;
+	s->total += cycles;
+	if (cycles < s->min)
+	{
+		s->min = cycles;
+	}
+	if (cycles > s->max)
+	{
+		s->max = cycles;
+	}
+}
+
+void prof_dump(void)
+{
+	printf_P(PSTR("Region count min max mean (cycles, %u MHz)\n"), (uint16_t)(F_CPU / 1000000UL));
+	dumpLine = 0;
+}
+
+void prof_task(void)
+{
+	uint8_t r = dumpLine;
+	ProfStats s;
+
+	if (r == DUMP_IDLE)
+	{
+		return;
+	}
+	dumpLine = (r + 1 < PROF_COUNT) ? (r + 1) : DUMP_IDLE;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // A consistent sample, see prof_reset()
+	{
+		s = profStats[r];
+	}
+	printf_P(PSTR("%S %lu %lu %lu %lu\n"), (PGM_P)pgm_read_word(&regionNames[r]), s.count, s.count ? s.min : 0,
+			 s.max, s.count ? (uint32_t)(s.total / s.count) : 0);
+}
+
+#endif // PROFILE
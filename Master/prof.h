@@ -0,0 +1,98 @@
+/*
+ * prof.h
+ *
+ * Created: 16.10.2026
+ *
+ * Cycle counting profiler. Timer5 runs at clk/1 and its overflows are
+ * counted, so regions of any length are measured to the cycle. Each region
+ * keeps its count, min, max and total; the cost of reading the clock is
+ * subtracted. Build with -DPROFILE=1, otherwise PROF_ENTER/PROF_EXIT
+ * expand to nothing and no timer, RAM or flash is used. PROFILE_GPIO=1
+ * also drives PLn high while region n runs, for a logic analyzer.
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+
+#ifndef PROFILE_GPIO
+#define PROFILE_GPIO 0
+#endif
+
+typedef enum
+{
+	PROF_LCD_PUTC,
+	PROF_LCD_WAITBUSY,
+	PROF_KEYPAD_SCAN,
+	PROF_SLAVE_SEND,
+	PROF_FSM_STEP,
+	PROF_COUNT // At most 8, one PORTL pin each
+} ProfRegion;
+
+#if PROFILE
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+typedef struct
+{
+	uint32_t start; // Cycle stamp of the open PROF_ENTER
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total; // For the mean
+} ProfStats;
+
+extern ProfStats profStats[PROF_COUNT];
+extern volatile uint16_t profOverflows;
+
+// Cycles since prof_init(), wraps after about 268 s
+static inline uint32_t prof_now(void)
+{
+	uint8_t sreg = SREG;
+	uint16_t ticks;
+	uint16_t overflows;
+
+	cli();
+	ticks = TCNT5;
+	overflows = profOverflows;
+	if ((TIFR5 & (1 << TOV5)) && (ticks < 0x8000))
+	{
+		overflows++; // Wrapped after cli(), the interrupt is still pending
+	}
+	SREG = sreg;
+	return ((uint32_t)overflows << 16) | ticks;
+}
+
+static inline void prof_enter(ProfRegion r)
+{
+#if PROFILE_GPIO
+	PORTL |= (1 << r);
+#endif
+	profStats[r].start = prof_now();
+}
+
+void prof_init(void);
+void prof_exit(ProfRegion r, uint32_t stop);
+void prof_reset(void);
+
+// Start printing the results over UART
+void prof_dump(void);
+void prof_task(void); // Every scheduler pass, prints one line while dumping
+
+#define PROF_ENTER(r) prof_enter(r)
+#define PROF_EXIT(r) prof_exit((r), prof_now())
+
+#else
+
+#define PROF_ENTER(r) ((void)0)
+#define PROF_EXIT(r) ((void)0)
+
+#endif // PROFILE
+
+#endif // PROF_H
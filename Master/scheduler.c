@@ -0,0 +1,212 @@
+/*
+ * scheduler.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "scheduler.h"
+#include "timer.h"
+
+#define WHEEL_MASK (SCHED_WHEEL_SLOTS - 1)
+
+typedef enum
+{
+	TIMER_FREE,
+	TIMER_ARMED,	// Linked into a wheel slot
+	TIMER_EXPIRING	// Detached while its slot is being processed
+} TimerState;
+
+typedef struct
+{
+	sched_timer_cb_t callback;
+	uint16_t period;
+	uint16_t rounds; // Full wheel turns left before the timer fires
+	uint8_t arg;
+	uint8_t slot;
+	uint8_t next; // Next timer in the same slot
+	TimerState state;
+} SchedTimer;
+
+typedef struct
+{
+	sched_task_t task;
+	uint16_t period;
+	uint32_t lastRun;
+} SchedTask;
+
+static SchedTimer timers[SCHED_MAX_TIMERS];
+static uint8_t wheel[SCHED_WHEEL_SLOTS]; // Head of the timer list of each slot
+static uint8_t wheelPos = 0;
+static uint32_t wheelTime = 0; // Millisecond the wheel has been advanced to
+
+static SchedTask tasks[SCHED_MAX_TASKS];
+static uint8_t taskCount = 0;
+
+// Link a timer into the slot delay ticks ahead of the current position
+static void wheel_insert(sched_timer_t id, uint16_t delay)
+{
+	if (delay == 0)
+	{
+		delay = 1; // Earliest possible expiry is the next tick
+	}
+
+	uint8_t slot = (wheelPos + delay) & WHEEL_MASK;
+
+	timers[id].rounds = (delay - 1) >> SCHED_WHEEL_BITS;
+	timers[id].slot = slot;
+	timers[id].next = wheel[slot];
+	timers[id].state = TIMER_ARMED;
+	wheel[slot] = id;
+}
+
+static void wheel_unlink(sched_timer_t id)
+{
+	uint8_t *link = &wheel[timers[id].slot];
+
+	while (*link != SCHED_TIMER_NONE)
+	{
+		if (*link == id)
+		{
+			*link = timers[id].next;
+			return;
+		}
+		link = &timers[*link].next;
+	}
+}
+
+// Move the wheel one tick forward and fire everything that expires on it
+static void wheel_advance(void)
+{
+	uint8_t expiring[SCHED_MAX_TIMERS];
+	uint8_t count = 0;
+
+	wheelPos = (wheelPos + 1) & WHEEL_MASK;
+
+	// Detach the whole slot first so callbacks can start and cancel timers freely
+	uint8_t id = wheel[wheelPos];
+	wheel[wheelPos] = SCHED_TIMER_NONE;
+	while (id != SCHED_TIMER_NONE)
+	{
+		timers[id].state = TIMER_EXPIRING;
+		expiring[count++] = id;
+		id = timers[id].next;
+	}
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		SchedTimer *t = &timers[expiring[i]];
+
+		if (t->state != TIMER_EXPIRING)
+		{
+			continue; // Cancelled (and maybe reused) by an earlier callback
+		}
+
+		if (t->rounds > 0)
+		{
+			t->rounds--;
+			t->next = wheel[wheelPos];
+			t->state = TIMER_ARMED;
+			wheel[wheelPos] = expiring[i];
+			continue;
+		}
+
+		if (t->period > 0)
+		{
+			wheel_insert(expiring[i], t->period);
+		}
+		else
+		{
+			t->state = TIMER_FREE;
+		}
+		t->callback(t->arg);
+	}
+}
+
+void sched_init(void)
+{
+	for (uint8_t i = 0; i < SCHED_WHEEL_SLOTS; i++)
+	{
+		wheel[i] = SCHED_TIMER_NONE;
+	}
+	for (uint8_t i = 0; i < SCHED_MAX_TIMERS; i++)
+	{
+		timers[i].state = TIMER_FREE;
+	}
+	taskCount = 0;
+	wheelPos = 0;
+	wheelTime = timer_millis();
+}
+
+bool sched_add_task(sched_task_t task, uint16_t period_ms)
+{
+	if (taskCount >= SCHED_MAX_TASKS)
+	{
+		return false;
+	}
+
+	tasks[taskCount].task = task;
+	tasks[taskCount].period = period_ms;
+	tasks[taskCount].lastRun = timer_millis();
+	taskCount++;
+	return true;
+}
+
+sched_timer_t sched_timer_start(uint16_t delay_ms, uint16_t period_ms, sched_timer_cb_t callback, uint8_t arg)
+{
+	for (sched_timer_t id = 0; id < SCHED_MAX_TIMERS; id++)
+	{
+		if (timers[id].state == TIMER_FREE)
+		{
+			timers[id].callback = callback;
+			timers[id].period = period_ms;
+			timers[id].arg = arg;
+			wheel_insert(id, delay_ms);
+			return id;
+		}
+	}
+	return SCHED_TIMER_NONE;
+}
+
+void sched_timer_cancel(sched_timer_t id)
+{
+	if (id >= SCHED_MAX_TIMERS)
+	{
+		return;
+	}
+	if (timers[id].state == TIMER_ARMED)
+	{
+		wheel_unlink(id);
+	}
+	timers[id].state = TIMER_FREE;
+}
+
+bool sched_timer_active(sched_timer_t id)
+{
+	return (id < SCHED_MAX_TIMERS) && (timers[id].state != TIMER_FREE);
+}
+
+bool sched_idle(void)
+{
+	return wheelTime == timer_millis();
+}
+
+void sched_run_once(void)
+{
+	uint32_t now = timer_millis();
+
+	// Catch up on every tick that elapsed since the last pass
+	while (wheelTime != now)
+	{
+		wheelTime++;
+		wheel_advance();
+	}
+
+	for (uint8_t i = 0; i < taskCount; i++)
+	{
+		if ((tasks[i].period == 0) || ((now - tasks[i].lastRun) >= tasks[i].period))
+		{
+			tasks[i].lastRun = now;
+			tasks[i].task();
+		}
+	}
+}
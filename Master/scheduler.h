@@ -0,0 +1,47 @@
+/*
+ * scheduler.h
+ *
+ * Created: 16.10.2026
+ *
+ * Cooperative run-to-completion scheduler. Tasks are plain functions that
+ * do a small amount of work and return; nothing in a task may busy-wait.
+ * Deadlines are kept in a hashed timer wheel with one slot per millisecond
+ * tick, so starting, cancelling and expiring a timer is cheap no matter how
+ * far in the future it fires.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCHED_MAX_TASKS 14
+#define SCHED_MAX_TIMERS 8
+#define SCHED_WHEEL_BITS 4 // 16 slots
+#define SCHED_WHEEL_SLOTS (1 << SCHED_WHEEL_BITS)
+
+#define SCHED_TIMER_NONE 0xFF
+
+typedef void (*sched_task_t)(void);
+typedef void (*sched_timer_cb_t)(uint8_t arg);
+typedef uint8_t sched_timer_t;
+
+void sched_init(void);
+
+// Register a task, period_ms 0 runs it on every pass of the loop
+bool sched_add_task(sched_task_t task, uint16_t period_ms);
+
+// Start a timer that calls callback(arg) after delay_ms. A non-zero period_ms
+// makes it periodic. Returns SCHED_TIMER_NONE if all timers are in use.
+sched_timer_t sched_timer_start(uint16_t delay_ms, uint16_t period_ms, sched_timer_cb_t callback, uint8_t arg);
+void sched_timer_cancel(sched_timer_t id);
+bool sched_timer_active(sched_timer_t id);
+
+// Process elapsed ticks and run every task that is due, then return
+void sched_run_once(void);
+
+// True if no tick has elapsed since the last sched_run_once() started
+bool sched_idle(void);
+
+#endif // SCHEDULER_H
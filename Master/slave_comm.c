@@ -0,0 +1,938 @@
+/*
+ * slave_comm.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "slave_comm.h"
+#include "prof.h"
+#include "console.h"
+#include "events.h"
+#include "timer.h"
+#include "../Common/ringbuf.h"
+#include <util/crc16.h>
+#include <util/delay.h>
+#include <util/atomic.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TWI_PROBE_SPINS 4000 // TWINT polls in slave_probe(), about 1 ms
+#define TWI_SCL (1 << PD0)
+#define TWI_SDA (1 << PD1)
+#define TWI_HALF_BIT_US 5 // 100 kHz while the bus is clocked by hand
+#define ATTN_PIN PD2	  // INT2, pulled low by a Slave with news
+
+#define TWI_START ((1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE))
+#define TWI_SEND ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+#define TWI_RECV_ACK (TWI_SEND | (1 << TWEA)) // Receive a byte, more to come
+#define TWI_RECV_NACK TWI_SEND				 // Receive the last byte
+#define TWI_STOP ((1 << TWINT) | (1 << TWSTO) | (1 << TWEN)) // Interrupt off, the bus goes idle
+#define TWI_STOP_START (TWI_STOP | (1 << TWSTA) | (1 << TWIE)) // STOP, then START the next one
+
+#define REPORT_IDLE 0xFF
+#define REPORT_LINES (SLAVE_STATUS_COUNT + CAR_COUNT + 1) // Recoveries, error classes, cars, broadcast
+
+// A transaction with the slave of car, queued by the FSM and carried out
+// by the TWI interrupt. A read fetches the status block into polled[car].
+typedef struct
+{
+	uint8_t car;
+	bool read;
+	uint8_t len;
+	uint8_t data[SLAVE_WRITE_MAX];
+	SlaveDone done;
+} SlaveWrite;
+
+// Finished transaction, handed back to slave_task() for the callback
+typedef struct
+{
+	uint8_t car;
+	bool read;
+	SlaveStatus status;
+	SlaveDone done;
+} SlaveResult;
+
+RINGBUF_DEFINE(writes, SlaveWrite, SLAVE_QUEUE_SIZE);
+RINGBUF_DEFINE(results, SlaveResult, SLAVE_QUEUE_SIZE);
+
+static writes_t writeQueue;	   // slave_write() -> TWI_vect
+static results_t resultQueue;  // TWI_vect -> slave_task()
+static volatile bool busy = false; // Set by slave_write(), cleared by the ISR when the queue runs dry
+static uint8_t sent = 0;		   // Bytes of the head transaction sent, ISR only
+static uint8_t tries = 0;		   // Failed attempts at the head transaction
+static volatile uint16_t startedAt; // timer_millis() when the current attempt started
+static volatile uint16_t errors[SLAVE_STATUS_COUNT]; // Failed attempts by class
+static uint16_t recoveries = 0;
+// Commands collected for each car and not yet sent. Up to a frame's worth
+// goes out at a time, the rest waits for the frame before it.
+typedef struct
+{
+	uint8_t len;
+	uint8_t payload[SLAVE_BATCH_MAX];
+} Batch;
+
+// What the Master last told a Slave output to do
+typedef enum
+{
+	OUTPUT_UNKNOWN, // After boot or a failed write
+	OUTPUT_OFF,
+	OUTPUT_ON
+} OutputShadow;
+
+// Frame sent to a car and not yet acknowledged, kept to send it again
+// while the Slave refuses it
+typedef struct
+{
+	bool inFlight;	// Queued or on the bus, or waiting for retryAt
+	bool waiting;	// Refused, sent again at retryAt
+	uint8_t len;
+	uint8_t data[PROTO_FRAME_MAX];
+	uint16_t backoff; // Current wait, ms
+	uint32_t retryAt;
+	uint32_t since; // timer_millis() of the first refusal
+} Pending;
+
+// Position of a car as last broadcast
+typedef struct
+{
+	bool known; // Cleared when a broadcast fails, to send it again
+	uint8_t floor;
+	uint8_t dir;
+} Position;
+
+// Indexed by car, or SLAVE_BROADCAST for the general call
+static Batch batches[CAR_COUNT + 1];
+static uint8_t nextSeq[CAR_COUNT + 1]; // PROTO_SEQ_RESYNC for the first frame after boot
+static SlaveStatus lastStatus[CAR_COUNT + 1];
+static uint16_t failures[CAR_COUNT + 1];
+static uint8_t sentSeq[CAR_COUNT + 1]; // seq of the last frame queued for the car
+
+static Pending pending[CAR_COUNT]; // Broadcasts are not retried, slave_position() sends them anew
+static bool resync[CAR_COUNT]; // LED commands did not fit, send the shadow once there is room
+static OutputShadow moveLed[CAR_COUNT];
+static OutputShadow doorLed[CAR_COUNT];
+static Position positions[CAR_COUNT];
+static uint8_t polled[CAR_COUNT][PROTO_STATUS_LEN]; // Filled by the ISR, one read per car at a time
+static bool polling[CAR_COUNT];
+static SlaveState states[CAR_COUNT];
+static volatile bool attention = false; // Set by INT2
+static bool resultsLost = false;
+static uint8_t reportLine = REPORT_IDLE; // Next line printed by slave_report_line()
+
+void twi_init(void)
+{
+	TWBR = 0x03; // TWI bit rate register.
+	TWSR = 0x00; // TWI status register prescaler value set to 1
+
+	TWCR |= (1 << TWEN); // Set to enable the TWI
+}
+
+bool twi_bus_idle(void)
+{
+	uint8_t lines = (1 << PD0) | (1 << PD1); // SCL, SDA
+
+	return (PIND & lines) == lines;
+}
+
+void slave_attention_init(void)
+{
+	DDRD &= ~(1 << ATTN_PIN);
+	PORTD |= (1 << ATTN_PIN);  // Pull-up, the Slaves only ever pull low
+	EICRA |= (1 << ISC21);	   // Falling edge
+	EICRA &= ~(1 << ISC20);
+	EIFR = (1 << INTF2);	   // Forget an edge from before
+	EIMSK |= (1 << INT2);
+}
+
+ISR(INT2_vect)
+{
+	attention = true;
+}
+
+// Frees the bus after a slave was left mid-byte holding SDA low. Up to
+// nine clocks let it shift out the rest of its byte, then a STOP resets
+// it. The pins are driven open drain through DDRD with PORTD low, the
+// external pull-ups give the high level.
+void twi_recover(void)
+{
+	TWCR = 0; // TWI off, the port drives the pins again
+	PORTD &= ~(TWI_SCL | TWI_SDA);
+	DDRD &= ~(TWI_SCL | TWI_SDA);
+	for (uint8_t i = 0; (i < 9) && !(PIND & TWI_SDA); i++)
+	{
+		DDRD |= TWI_SCL;
+		_delay_us(TWI_HALF_BIT_US);
+		DDRD &= ~TWI_SCL;
+		_delay_us(TWI_HALF_BIT_US);
+	}
+
+	// STOP: SDA rises while SCL is high
+	DDRD |= TWI_SCL;
+	_delay_us(TWI_HALF_BIT_US);
+	DDRD |= TWI_SDA;
+	_delay_us(TWI_HALF_BIT_US);
+	DDRD &= ~TWI_SCL;
+	_delay_us(TWI_HALF_BIT_US);
+	DDRD &= ~TWI_SDA;
+	_delay_us(TWI_HALF_BIT_US);
+
+	recoveries++;
+	twi_init();
+}
+
+// Waits for TWINT, giving up after about a millisecond
+static bool twi_wait_bounded(void)
+{
+	for (uint16_t n = 0; n < TWI_PROBE_SPINS; n++)
+	{
+		if (TWCR & (1 << TWINT))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Addresses the slave of car without sending data, the slave sees a
+// START, its address and a STOP. Polled, only used at boot before the
+// interrupt driven writes start.
+bool slave_probe(uint8_t car)
+{
+	bool ack = false;
+
+	TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN); // Send START
+	if (twi_wait_bounded() && ((TWSR & 0xF8) == 0x08)) // START sent
+	{
+		TWDR = ((SLAVE_ADDRESS + car) << 1); // SLA+W
+		TWCR = (1 << TWINT) | (1 << TWEN);
+		ack = twi_wait_bounded() && ((TWSR & 0xF8) == 0x18); // SLA+W sent, ACK received
+	}
+	TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO); // Send STOP
+	return ack;
+}
+
+// Starts an attempt at the head transaction. Called from the ISR, or with
+// the TWI interrupt off.
+static void attempt(uint8_t twcr)
+{
+	sent = 0;
+	startedAt = (uint16_t)timer_millis();
+	PROF_ENTER(PROF_SLAVE_SEND);
+	TWCR = twcr;
+}
+
+// Ends the head transaction and starts the next one, if any. STOP and
+// START are requested together so back-to-back writes go out without a gap.
+// A failed attempt is retried until TWI_ATTEMPTS are used up, except a general
+// call nobody acknowledged: there is no landing indicator to answer it.
+static void finish(SlaveStatus status)
+{
+	SlaveWrite *w = writes_peek(&writeQueue);
+	SlaveResult r = {w->car, w->read, status, w->done};
+
+	PROF_EXIT(PROF_SLAVE_SEND);
+	if ((status != SLAVE_OK) && !((status == SLAVE_NACK_ADDRESS) && (w->car == SLAVE_BROADCAST))) // See report()
+	{
+		errors[status]++;
+		if (++tries < TWI_ATTEMPTS)
+		{
+			// After lost arbitration the TWI is no longer master, it only needs a START
+			attempt((status == SLAVE_ARBITRATION) ? TWI_START : TWI_STOP_START);
+			return;
+		}
+	}
+	tries = 0;
+	if (!results_push(&resultQueue, r))
+	{
+		resultsLost = true;
+	}
+	writes_drop(&writeQueue);
+
+	if (writes_empty(&writeQueue))
+	{
+		busy = false;
+		TWCR = TWI_STOP;
+		return;
+	}
+	attempt(TWI_STOP_START);
+}
+
+ISR(TWI_vect)
+{
+	SlaveWrite *w = writes_peek(&writeQueue);
+
+	switch (TWSR & 0xF8)
+	{
+	case 0x08: // START sent
+	case 0x10: // Repeated START sent
+		TWDR = ((w->car == SLAVE_BROADCAST) ? PROTO_GENERAL_CALL : ((SLAVE_ADDRESS + w->car) << 1)) |
+			   (w->read ? 1 : 0); // SLA+R or SLA+W
+		TWCR = TWI_SEND;
+		break;
+	case 0x18: // SLA+W sent, ACK received
+	case 0x28: // Data sent, ACK received
+		if (sent < w->len)
+		{
+			TWDR = w->data[sent++];
+			TWCR = TWI_SEND;
+		}
+		else
+		{
+			finish(SLAVE_OK);
+		}
+		break;
+	case 0x20: // SLA+W sent, NACK received: no slave at that address
+		finish(SLAVE_NACK_ADDRESS);
+		break;
+	case 0x30: // Data sent, NACK received
+		finish(SLAVE_NACK_DATA);
+		break;
+	case 0x38: // Arbitration lost in SLA+R/W, data or NACK
+		finish(SLAVE_ARBITRATION);
+		break;
+	case 0x40: // SLA+R sent, ACK received
+		TWCR = (w->len > 1) ? TWI_RECV_ACK : TWI_RECV_NACK;
+		break;
+	case 0x48: // SLA+R sent, NACK received
+		finish(SLAVE_NACK_ADDRESS);
+		break;
+	case 0x50: // Data received, ACK returned
+		polled[w->car][sent++] = TWDR;
+		TWCR = (sent < w->len - 1) ? TWI_RECV_ACK : TWI_RECV_NACK;
+		break;
+	case 0x58: // Data received, NACK returned: that was the last byte
+		polled[w->car][sent++] = TWDR;
+		finish(SLAVE_OK);
+		break;
+	case 0x00: // Bus error, illegal START or STOP
+		finish(SLAVE_BUS_ERROR);
+		break;
+	default:
+		finish(SLAVE_UNEXPECTED);
+		break;
+	}
+}
+
+// Queues a transaction and starts the bus if it is idle
+static bool enqueue(const SlaveWrite *w)
+{
+	if (!writes_push(&writeQueue, *w))
+	{
+		printf("Slave queue full\n");
+		return false;
+	}
+
+	if (!busy) // The ISR is idle and its interrupt off, nothing races with this
+	{
+		busy = true;
+		for (uint16_t n = 0; TWCR & (1 << TWSTO); n++) // The previous STOP is still going out, a few us
+		{
+			if (n == TWI_PROBE_SPINS) // Something holds SCL low
+			{
+				twi_recover();
+				break;
+			}
+		}
+		attempt(TWI_START);
+	}
+	return true;
+}
+
+// Queues a write of len bytes to the slave of car and returns at once.
+// done, if not NULL, is called from slave_task() with the outcome.
+bool slave_write(uint8_t car, const uint8_t *data, uint8_t len, SlaveDone done)
+{
+	SlaveWrite w;
+
+	if ((len == 0) || (len > SLAVE_WRITE_MAX))
+	{
+		return false;
+	}
+	w.car = car;
+	w.read = false;
+	w.len = len;
+	w.done = done;
+	memcpy(w.data, data, len);
+	return enqueue(&w);
+}
+
+// Queues a read of the status block of car, unless one is already on its
+// way. The result shows up in slave_state() a few hundred us later.
+bool slave_poll(uint8_t car)
+{
+	SlaveWrite w;
+
+	if (polling[car])
+	{
+		return true;
+	}
+	w.car = car;
+	w.read = true;
+	w.len = PROTO_STATUS_LEN;
+	w.done = NULL;
+	polling[car] = enqueue(&w);
+	return polling[car];
+}
+
+// Forgets what the Master assumed about the outputs of car, after a frame
+// for it may have been lost
+static void forget(uint8_t car)
+{
+	if (car == SLAVE_BROADCAST)
+	{
+		for (uint8_t i = 0; i < CAR_COUNT; i++)
+		{
+			positions[i].known = false; // Sent again with the next pass
+		}
+	}
+	else
+	{
+		moveLed[car] = OUTPUT_UNKNOWN;
+		doorLed[car] = OUTPUT_UNKNOWN;
+	}
+}
+
+// Appends the LED states the Slave of car should end up with, after LED
+// commands were merged for lack of room. Behind everything already
+// collected, so they are what the Slave is left with.
+static void resend(uint8_t car)
+{
+	Batch *b = &batches[car];
+
+	if (!resync[car] || (b->len + 2 > SLAVE_BATCH_MAX))
+	{
+		return;
+	}
+	resync[car] = false;
+	if (moveLed[car] != OUTPUT_UNKNOWN)
+	{
+		b->payload[b->len++] = (moveLed[car] == OUTPUT_ON) ? PROTO_MOVE_ON : PROTO_MOVE_OFF;
+	}
+	if (doorLed[car] != OUTPUT_UNKNOWN)
+	{
+		b->payload[b->len++] = (doorLed[car] == OUTPUT_ON) ? PROTO_DOOR_OPEN : PROTO_DOOR_CLOSE;
+	}
+}
+
+// Seals the oldest commands collected for car, as many whole ones as fit,
+// into a frame and queues it. With the queue full, or the previous frame
+// for the car not through yet, the commands are kept for a later pass and
+// false returned.
+static bool flush(uint8_t car)
+{
+	Batch *b = &batches[car];
+	uint8_t buffer[PROTO_FRAME_MAX];
+	uint8_t *frame = (car == SLAVE_BROADCAST) ? buffer : pending[car].data;
+	uint8_t len = 0;
+	uint8_t crc = 0;
+	uint8_t take = 0;
+
+	if ((car != SLAVE_BROADCAST) && pending[car].inFlight)
+	{
+		return false; // Sent behind it, the frame could overtake a retry
+	}
+	if (car != SLAVE_BROADCAST)
+	{
+		resend(car);
+	}
+	if (b->len == 0)
+	{
+		return true;
+	}
+	while (take < b->len)
+	{
+		uint8_t next = take + 1 + proto_arg_len(b->payload[take]);
+
+		if (next > PROTO_PAYLOAD_MAX)
+		{
+			break;
+		}
+		take = next;
+	}
+	frame[len++] = nextSeq[car];
+	frame[len++] = take;
+	memcpy(&frame[len], b->payload, take);
+	len += take;
+	for (uint8_t i = 0; i < len; i++)
+	{
+		crc = _crc8_ccitt_update(crc, frame[i]);
+	}
+	frame[len++] = crc;
+
+	if (!slave_write(car, frame, len, NULL))
+	{
+		return false; // Same seq next time, the Slave has not seen this one
+	}
+	if (car != SLAVE_BROADCAST)
+	{
+		pending[car].inFlight = true;
+		pending[car].waiting = false;
+		pending[car].len = len;
+		pending[car].backoff = 0;
+	}
+	sentSeq[car] = nextSeq[car];
+	nextSeq[car] = (nextSeq[car] == 0xFF) ? 1 : (nextSeq[car] + 1); // 0 is only used once
+	b->len -= take;
+	memmove(b->payload, &b->payload[take], b->len);
+	return true;
+}
+
+// True if the command would leave the Slave's LEDs as they are. Updates
+// the shadow otherwise.
+static bool redundant(uint8_t car, uint8_t command)
+{
+	OutputShadow *output;
+	OutputShadow value;
+
+	if (car == SLAVE_BROADCAST)
+	{
+		return false; // Deduplicated by slave_position()
+	}
+
+	switch (command)
+	{
+	case PROTO_MOVE_ON:
+		output = &moveLed[car];
+		value = OUTPUT_ON;
+		break;
+	case PROTO_MOVE_OFF:
+		output = &moveLed[car];
+		value = OUTPUT_OFF;
+		break;
+	case PROTO_DOOR_OPEN:
+		output = &doorLed[car];
+		value = OUTPUT_ON;
+		break;
+	case PROTO_DOOR_CLOSE:
+		output = &doorLed[car];
+		value = OUTPUT_OFF;
+		break;
+	case PROTO_BLINK:
+		moveLed[car] = OUTPUT_OFF; // Ends with the LED off
+		return false;
+	case PROTO_EMERGENCY:
+		doorLed[car] = OUTPUT_OFF; // Door LED is closed again at the end
+		return false;
+	default:
+		return false;
+	}
+	if (*output == value)
+	{
+		return true;
+	}
+	*output = value;
+	return false;
+}
+
+// True for a command that only sets an LED, which the shadow can stand in for
+static bool led_command(uint8_t command)
+{
+	return (command == PROTO_MOVE_ON) || (command == PROTO_MOVE_OFF) || (command == PROTO_DOOR_OPEN) ||
+		   (command == PROTO_DOOR_CLOSE);
+}
+
+// Adds a command and its arguments to the commands collected for car
+static void batch(uint8_t car, const uint8_t *command, uint8_t len)
+{
+	Batch *b = &batches[car];
+
+	if (redundant(car, command[0]))
+	{
+		return;
+	}
+	if ((b->len + len > SLAVE_BATCH_MAX) && !flush(car) && (b->len + len > SLAVE_BATCH_MAX))
+	{
+		if (car == SLAVE_BROADCAST)
+		{
+			forget(car); // Positions are sent again with the next pass
+			return;
+		}
+		resync[car] = true; // The shadow holds what the LEDs should show
+		if (!led_command(command[0]))
+		{
+			failures[car]++; // No room for the effect, it is lost
+		}
+		return;
+	}
+	memcpy(&b->payload[b->len], command, len);
+	b->len += len;
+}
+
+// Queues a command for the slave of car, the FSM never talks to the bus directly
+void queueCommandToSlave(uint8_t car, uint8_t command)
+{
+	batch(car, &command, 1);
+}
+
+void queueCommandArgToSlave(uint8_t car, uint8_t command, uint8_t arg)
+{
+	uint8_t cmd[2] = {command, arg};
+
+	batch(car, cmd, sizeof(cmd));
+}
+
+// Sets a timing parameter of the slave of car, which keeps it in its EEPROM
+void sendParamToSlave(uint8_t car, uint8_t param, uint16_t value)
+{
+	uint8_t cmd[4] = {PROTO_SET_PARAM, param, value & 0xFF, value >> 8};
+
+	batch(car, cmd, sizeof(cmd));
+}
+
+// Publishes the position of car to every landing indicator with one
+// general call. Only changes go out, the cars moving in a pass share a frame.
+void slave_position(uint8_t car, uint8_t floor, uint8_t dir)
+{
+	Position *p = &positions[car];
+	uint8_t cmd[4] = {PROTO_POSITION, car, floor, dir};
+
+	if (p->known && (p->floor == floor) && (p->dir == dir))
+	{
+		return;
+	}
+	p->known = true;
+	p->floor = floor;
+	p->dir = dir;
+	batch(SLAVE_BROADCAST, cmd, sizeof(cmd));
+}
+
+SlaveStatus slave_last_status(uint8_t car)
+{
+	return lastStatus[car];
+}
+
+uint16_t slave_failures(uint8_t car)
+{
+	return failures[car];
+}
+
+const SlaveState *slave_state(uint8_t car)
+{
+	return states[car].valid ? &states[car] : NULL;
+}
+
+// The last status block was read after the Slave carried out every frame
+// sent to it and finished its effects
+bool slave_confirmed(uint8_t car)
+{
+	const SlaveState *s = &states[car];
+
+	return s->valid && (batches[car].len == 0) && !resync[car] && (s->seq == sentSeq[car]) && (s->queued == 0) &&
+		   (s->effect == PROTO_EFFECT_NONE);
+}
+
+static uint16_t get16(const uint8_t *block, uint8_t offset)
+{
+	return block[offset] | (block[offset + 1] << 8);
+}
+
+// Takes over a status block read by the ISR, if its CRC is right
+static bool parse_state(uint8_t car)
+{
+	const uint8_t *block = polled[car];
+	SlaveState *s = &states[car];
+	uint8_t crc = 0;
+
+	for (uint8_t i = 0; i < PROTO_STATUS_CRC; i++)
+	{
+		crc = _crc8_ccitt_update(crc, block[i]);
+	}
+	if (crc != block[PROTO_STATUS_CRC])
+	{
+		return false;
+	}
+	s->outputs = block[PROTO_STATUS_OUTPUTS];
+	s->effect = block[PROTO_STATUS_EFFECT];
+	s->seq = block[PROTO_STATUS_SEQ];
+	s->queued = block[PROTO_STATUS_QUEUED];
+	s->badFrames = get16(block, PROTO_STATUS_BAD_FRAMES);
+	s->dropped = get16(block, PROTO_STATUS_DROPPED);
+	s->busErrors = get16(block, PROTO_STATUS_BUS_ERRORS);
+	s->timeouts = get16(block, PROTO_STATUS_TIMEOUTS);
+	s->attention = block[PROTO_STATUS_ATTENTION];
+	s->at = timer_millis();
+	s->valid = true;
+	return true;
+}
+
+static const char statusOk[] PROGMEM = "ok";
+static const char statusNackAddress[] PROGMEM = "nack-address";
+static const char statusNackData[] PROGMEM = "nack-data";
+static const char statusArbitration[] PROGMEM = "arbitration";
+static const char statusBusError[] PROGMEM = "bus-error";
+static const char statusTimeout[] PROGMEM = "timeout";
+static const char statusUnexpected[] PROGMEM = "unexpected";
+
+static PGM_P const statusNames[SLAVE_STATUS_COUNT] PROGMEM = {
+	statusOk,
+	statusNackAddress,
+	statusNackData,
+	statusArbitration,
+	statusBusError,
+	statusTimeout,
+	statusUnexpected,
+};
+
+static PGM_P statusName(SlaveStatus status)
+{
+	return (PGM_P)pgm_read_word(&statusNames[status]);
+}
+
+void slave_report(void)
+{
+	reportLine = 0;
+}
+
+// Line n of the report: the recoveries, one line per error class, one per
+// car and the general call
+bool slave_report_line(void)
+{
+	uint8_t n = reportLine;
+	uint16_t count;
+
+	if (n == REPORT_IDLE)
+	{
+		return false;
+	}
+	reportLine = (n < REPORT_LINES - 1) ? (n + 1) : REPORT_IDLE;
+
+	if (n == 0)
+	{
+		printf_P(PSTR("TWI recoveries %u\n"), recoveries);
+	}
+	else if (n < SLAVE_STATUS_COUNT) // Error class n, SLAVE_OK is not one
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // Counted by the ISR
+		{
+			count = errors[n];
+		}
+		printf_P(PSTR("%S %u\n"), statusName(n), count);
+	}
+	else if (n < SLAVE_STATUS_COUNT + CAR_COUNT)
+	{
+		uint8_t car = n - SLAVE_STATUS_COUNT;
+		const SlaveState *s = &states[car];
+
+		printf_P(PSTR("Car %u failed %u last %S"), car, failures[car], statusName(lastStatus[car]));
+		if (s->valid)
+		{
+			printf_P(PSTR(", slave bad %u dropped %u bus %u timeouts %u"), s->badFrames, s->dropped, s->busErrors,
+					 s->timeouts);
+		}
+		printf_P(PSTR("\n"));
+	}
+	else
+	{
+		printf_P(PSTR("Broadcast failed %u last %S\n"), failures[SLAVE_BROADCAST],
+				 statusName(lastStatus[SLAVE_BROADCAST]));
+	}
+	return true;
+}
+
+// Acts on the reason a Slave raised the attention line
+static void attend(uint8_t car)
+{
+	const SlaveState *s = &states[car];
+
+	if ((s->attention & PROTO_ATTN_FAULT) && CONSOLE_VERBOSE(CONSOLE_INFO))
+	{
+		printf_P(PSTR("Car %u slave bad %u dropped %u bus %u timeouts %u\n"), car, s->badFrames, s->dropped,
+				 s->busErrors, s->timeouts);
+	}
+	if ((s->attention & PROTO_ATTN_DONE) && slave_confirmed(car)) // Not if more was sent since
+	{
+		event_post_car(car, EVT_SLAVE_DONE, 0);
+	}
+}
+
+// A frame the Slave of car refused, with its queue full behind a long
+// effect, is sent again after a wait that doubles up to
+// SLAVE_BACKOFF_CAP_MS. True while it is to be retried, false once
+// SLAVE_BACKOFF_LIMIT_MS have passed.
+static bool backoff(uint8_t car)
+{
+	Pending *p = &pending[car];
+	uint32_t now = timer_millis();
+
+	if (p->backoff == 0)
+	{
+		p->since = now;
+		p->backoff = SLAVE_BACKOFF_MS;
+	}
+	else if (now - p->since >= SLAVE_BACKOFF_LIMIT_MS)
+	{
+		return false;
+	}
+	else if (p->backoff < SLAVE_BACKOFF_CAP_MS)
+	{
+		p->backoff = (p->backoff * 2 < SLAVE_BACKOFF_CAP_MS) ? (p->backoff * 2) : SLAVE_BACKOFF_CAP_MS;
+	}
+	p->waiting = true;
+	p->retryAt = now + p->backoff;
+	return true;
+}
+
+// Sends the refused frames whose wait is over
+static void retry(void)
+{
+	uint32_t now = timer_millis();
+
+	for (uint8_t car = 0; car < CAR_COUNT; car++)
+	{
+		Pending *p = &pending[car];
+
+		if (p->waiting && ((int32_t)(now - p->retryAt) >= 0) && slave_write(car, p->data, p->len, NULL))
+		{
+			p->waiting = false;
+		}
+	}
+}
+
+static void report(const SlaveResult *r)
+{
+	if ((r->car == SLAVE_BROADCAST) && (r->status == SLAVE_NACK_ADDRESS))
+	{
+		lastStatus[r->car] = r->status;
+		return; // No landing indicator on the bus, nothing was lost
+	}
+	if (!r->read && (r->car != SLAVE_BROADCAST))
+	{
+		if ((r->status == SLAVE_NACK_DATA) && backoff(r->car))
+		{
+			return; // Not a failure yet, the Slave is busy
+		}
+		pending[r->car].inFlight = false;
+	}
+	lastStatus[r->car] = r->status;
+	if (r->read)
+	{
+		polling[r->car] = false; // polled[car] is free again
+		if (r->status == SLAVE_OK)
+		{
+			if (parse_state(r->car))
+			{
+				attend(r->car);
+			}
+			else if (CONSOLE_VERBOSE(CONSOLE_INFO))
+			{
+				printf_P(PSTR("Car %u bad status block\n"), r->car);
+			}
+		}
+	}
+	if (r->status != SLAVE_OK)
+	{
+		failures[r->car]++;
+		if (!r->read)
+		{
+			forget(r->car); // The frame may not have arrived
+		}
+		if (CONSOLE_VERBOSE(CONSOLE_INFO))
+		{
+			printf_P(PSTR("Car %u slave %S\n"), r->car, statusName(r->status));
+		}
+	}
+	if (r->done != NULL)
+	{
+		r->done(r->car, r->status);
+	}
+}
+
+// Aborts the attempt on the bus once it is past its deadline, then
+// recovers the bus and retries or gives up. The TWI and its interrupt are
+// switched off first, which makes the ISR's end of the queues safe to use
+// from here.
+static void check_deadline(void)
+{
+	SlaveWrite *w;
+	SlaveResult r;
+	bool late;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		late = busy && ((uint16_t)((uint16_t)timer_millis() - startedAt) >= TWI_TIMEOUT_MS);
+		if (late)
+		{
+			TWCR = 0;
+		}
+	}
+	if (!late)
+	{
+		return;
+	}
+
+	PROF_EXIT(PROF_SLAVE_SEND);
+	errors[SLAVE_TIMEOUT]++;
+	twi_recover();
+	if (++tries < TWI_ATTEMPTS)
+	{
+		attempt(TWI_START);
+		return;
+	}
+
+	tries = 0;
+	w = writes_peek(&writeQueue);
+	r.car = w->car;
+	r.read = w->read;
+	r.status = SLAVE_TIMEOUT;
+	r.done = w->done;
+	writes_drop(&writeQueue);
+	if (writes_empty(&writeQueue))
+	{
+		busy = false;
+	}
+	else
+	{
+		attempt(TWI_START);
+	}
+	report(&r);
+}
+
+// Polls every Slave after the attention line fell. The line is shared, a
+// second Slave pulling it while the first still holds it makes no edge,
+// so a line that stays low is polled again every SLAVE_ATTN_REPOLL_MS.
+static void check_attention(void)
+{
+	static uint32_t polledAt = 0;
+	uint32_t now = timer_millis();
+
+	if (!attention && ((PIND & (1 << ATTN_PIN)) || (now - polledAt < SLAVE_ATTN_REPOLL_MS)))
+	{
+		return;
+	}
+	attention = false;
+	polledAt = now;
+	for (uint8_t car = 0; car < CAR_COUNT; car++)
+	{
+		slave_poll(car);
+	}
+}
+
+// Sends the frames collected during the pass, enforces the bus deadline
+// and hands the finished transactions to their callbacks, outside the ISR
+void slave_task(void)
+{
+	SlaveResult r;
+
+	retry();
+	for (uint8_t car = 0; car <= SLAVE_BROADCAST; car++)
+	{
+		while (flush(car) && (batches[car].len > 0))
+		{
+			// Only the broadcast goes on, a car waits for the outcome of its frame
+		}
+	}
+	check_attention();
+
+	if (resultsLost)
+	{
+		resultsLost = false;
+		printf("Slave results lost\n");
+	}
+	while (results_pop(&resultQueue, &r))
+	{
+		report(&r);
+	}
+	check_deadline(); // After the results, a timeout is always the newest
+}
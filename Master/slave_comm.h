@@ -0,0 +1,118 @@
+/*
+ * slave_comm.h
+ *
+ * Created: 16.10.2026
+ *
+ * I2C/TWI link to the Slaves, one per car. Writes are queued with the car
+ * they are for and sent by the TWI interrupt, so queueing never waits for
+ * the bus. The outcome of each write, including a NACK, is reported
+ * through an optional callback run from slave_task().
+ *
+ * Commands for a car are collected during a scheduler pass and sent as
+ * one frame (Common/protocol.h) by slave_task(). A shadow of the Slave's
+ * LEDs drops commands that would not change anything.
+ *
+ * Every transaction has a deadline. A write the bus does not finish in
+ * TWI_TIMEOUT_MS is aborted, the bus is recovered and the write retried;
+ * the Slave drops a retried frame it already executed by its sequence
+ * number. Failures are counted by class for the "twi" console command.
+ *
+ * A Slave refuses frames (NACK) while its queue is full, which happens
+ * behind an effect that lasts seconds. A refused frame is sent again after
+ * a growing wait until SLAVE_BACKOFF_LIMIT_MS have passed, and a car has
+ * one frame on its way at a time so its frames stay in order. Commands
+ * collected meanwhile wait, up to SLAVE_BATCH_MAX bytes. Past that the
+ * LED commands are merged into the final state of the LEDs, which is
+ * sent once there is room; an effect that does not fit is lost.
+ *
+ * slave_poll() reads a Slave's status block. Once the block shows the
+ * last frame carried out, slave_confirmed() is true and the Master knows
+ * the Slave's outputs rather than assuming them.
+ *
+ * The Slaves share an open drain attention line to INT2 (PD2). When it
+ * falls every Slave is polled; a Slave that reports its effects done and
+ * everything carried out makes slave_task() post EVT_SLAVE_DONE, so the
+ * FSM does not have to sit out a fixed time.
+ *
+ * slave_position() publishes where each car is to the landing indicators
+ * with the TWI general call. One frame reaches every node whatever the
+ * number of floors, each node picks out the car it shows. Without any
+ * indicator the general call is not acknowledged, which is not an error
+ * and is neither retried nor sent again.
+ */
+
+#ifndef SLAVE_COMM_H
+#define SLAVE_COMM_H
+
+#include <avr/io.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../Common/protocol.h"
+
+#define SLAVE_ADDRESS 0b1010111 // 87 as decimal, address of car 0
+#define SLAVE_QUEUE_SIZE 16		// Writes waiting to be sent to the slaves, power of two
+#define SLAVE_WRITE_MAX PROTO_FRAME_MAX // Longest write
+#define SLAVE_BATCH_MAX (4 * PROTO_PAYLOAD_MAX) // Command bytes held per car while its frame is on its way
+#define TWI_TIMEOUT_MS 10				// Deadline of one attempt, a frame takes ~0.2 ms
+#define TWI_ATTEMPTS 3					// Tries at a write before it is reported as failed
+#define SLAVE_ATTN_REPOLL_MS 10			// Poll period while the attention line stays low
+#define SLAVE_BACKOFF_MS 20				// First wait before a refused frame is sent again, doubles
+#define SLAVE_BACKOFF_CAP_MS 2000		// Longest single wait
+#define SLAVE_BACKOFF_LIMIT_MS 25000UL	// Give up, longer than the longest effect (6 x 2000 ms notes + 10000 ms hold)
+
+// Cars in the group, car n is the Slave built with CAR_ID=n at SLAVE_ADDRESS + n
+#ifndef CAR_COUNT
+#define CAR_COUNT 1
+#endif
+#define SLAVE_BROADCAST CAR_COUNT // Car index of the general call, see slave_position()
+
+typedef enum
+{
+	SLAVE_OK,
+	SLAVE_NACK_ADDRESS, // No slave answered, missing or busy
+	SLAVE_NACK_DATA,	// Slave refused a byte
+	SLAVE_ARBITRATION,	// Arbitration lost, a glitch as there is no other master
+	SLAVE_BUS_ERROR,	// Illegal START or STOP seen on the bus
+	SLAVE_TIMEOUT,		// Deadline passed, the bus was recovered
+	SLAVE_UNEXPECTED,	// TWSR status that the write path does not expect
+	SLAVE_STATUS_COUNT
+} SlaveStatus;
+
+typedef void (*SlaveDone)(uint8_t car, SlaveStatus status);
+
+// Status block of a Slave as last read, see Common/protocol.h
+typedef struct
+{
+	bool valid;		// A block was read since boot
+	uint8_t outputs; // PROTO_OUT_* bits
+	uint8_t effect;	 // PROTO_EFFECT_*
+	uint8_t seq;	 // Last frame carried out
+	uint8_t queued;	 // Frames waiting on the Slave
+	uint16_t badFrames;
+	uint16_t dropped;
+	uint16_t busErrors;
+	uint16_t timeouts;
+	uint8_t attention; // PROTO_ATTN_* reported with this block
+	uint32_t at; // timer_millis() of the read
+} SlaveState;
+
+void twi_init(void);
+bool twi_bus_idle(void);		 // SCL and SDA released, nothing holds the bus
+void twi_recover(void);			 // Clocks a stuck SDA free, sends STOP, restarts the TWI
+void slave_attention_init(void); // INT2 on the attention line
+bool slave_probe(uint8_t car); // Slave of car acknowledges its address
+bool slave_write(uint8_t car, const uint8_t *data, uint8_t len, SlaveDone done);
+void queueCommandToSlave(uint8_t car, uint8_t command);
+void queueCommandArgToSlave(uint8_t car, uint8_t command, uint8_t arg);
+void sendParamToSlave(uint8_t car, uint8_t param, uint16_t value);
+void slave_position(uint8_t car, uint8_t floor, uint8_t dir); // dir is PROTO_DIR_*
+bool slave_poll(uint8_t car); // Queues a read of the status block
+const SlaveState *slave_state(uint8_t car); // NULL until a block was read
+bool slave_confirmed(uint8_t car);			// Everything sent has been carried out
+SlaveStatus slave_last_status(uint8_t car);
+uint16_t slave_failures(uint8_t car); // Writes that did not complete
+void slave_report(void);			  // Starts the listing of error counters by class and by car
+bool slave_report_line(void);		  // Prints its next line, false once it is done
+void slave_task(void);				  // Runs the completion callbacks
+
+#endif // SLAVE_COMM_H
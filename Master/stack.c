@@ -0,0 +1,78 @@
+/*
+ * stack.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "stack.h"
+#include "events.h"
+#include "elevator.h"
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Provided by the avr-libc linker script
+extern uint8_t __data_start;
+extern uint8_t __data_end;
+extern uint8_t __bss_start;
+extern uint8_t __bss_end;
+extern uint8_t __heap_start; // Nothing calls malloc(), this is where the free RAM starts
+
+static uint8_t *edge = NULL; // Lowest byte the stack has reached
+static bool guardTripped = false;
+
+// Runs after .init2 has set up SP and before .data and .bss are filled
+void stack_paint(void) __attribute__((naked, used, section(".init3")));
+void stack_paint(void)
+{
+	uint8_t *p = &__heap_start;
+
+	while (p < (uint8_t *)(uintptr_t)SP)
+	{
+		*p++ = STACK_CANARY;
+	}
+}
+
+// Moves edge down to the deepest byte the stack has overwritten. Always
+// scans up from the bottom: a frame can leave painted bytes between the
+// used ones, so walking down from the old edge would stop at the first
+// such gap. The scan ends at the old edge and costs at most the headroom.
+static void scan(void)
+{
+	uint8_t *p = &__heap_start;
+	uint8_t *top = (edge == NULL) ? ((uint8_t *)RAMEND + 1) : edge;
+
+	while ((p < top) && (*p == STACK_CANARY))
+	{
+		p++;
+	}
+	edge = p;
+}
+
+uint16_t stack_headroom(void)
+{
+	scan();
+	return edge - &__heap_start;
+}
+
+void stack_report(void)
+{
+	uint16_t headroom = stack_headroom();
+
+	printf_P(PSTR("RAM data %u bss %u stack peak %u now %u headroom %u\n"), (uint16_t)(&__data_end - &__data_start),
+			 (uint16_t)(&__bss_end - &__bss_start), (uint16_t)((uint8_t *)RAMEND + 1 - edge),
+			 (uint16_t)(RAMEND - SP), headroom);
+}
+
+void stack_task(void)
+{
+	uint16_t headroom = stack_headroom();
+
+	if ((STACK_GUARD_BYTES > 0) && !guardTripped && (headroom < STACK_GUARD_BYTES))
+	{
+		guardTripped = true; // Once, the mark never goes back up
+		printf_P(PSTR("Stack headroom %u bytes\n"), headroom);
+		event_post(EVT_FAULT, FAULT_STACK);
+	}
+}
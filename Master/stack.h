@@ -0,0 +1,33 @@
+/*
+ * stack.h
+ *
+ * Created: 16.10.2026
+ *
+ * Stack high-water mark. The free RAM between the end of .bss and the
+ * stack is painted with STACK_CANARY before main() runs, stack_task()
+ * follows the lowest byte the stack has overwritten since. Bytes that
+ * happen to equal the canary make the mark optimistic by a few bytes.
+ */
+
+#ifndef STACK_H
+#define STACK_H
+
+#include <stdint.h>
+
+#define STACK_CANARY 0xC5
+#define STACK_CHECK_MS 100 // stack_task() period
+
+// Headroom below which the cars are put in FAULT, 0 disables the guard
+#ifndef STACK_GUARD_BYTES
+#define STACK_GUARD_BYTES 256
+#endif
+
+// Bytes between the end of .bss and the deepest stack seen so far
+uint16_t stack_headroom(void);
+
+// Static data, BSS, peak stack and headroom over UART
+void stack_report(void);
+
+void stack_task(void);
+
+#endif // STACK_H
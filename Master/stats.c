@@ -0,0 +1,169 @@
+/*
+ * stats.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "stats.h"
+#include "calls.h"
+#include "timer.h"
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DUMP_IDLE 0xFF
+#define DUMP_STATE_LINES (CAR_COUNT * STATE_COUNT)
+#define DUMP_LINES (1 + DUMP_STATE_LINES + STATS_WAIT_BUCKETS + 1)
+
+// Upper limit of each wait bucket in seconds, the last one takes the rest
+static const uint8_t waitLimits[STATS_WAIT_BUCKETS] PROGMEM = {5, 10, 20, 30, 45, 60, 90, 255};
+
+static Stats stats;
+static Stats snapshot; // Copy being printed
+static uint32_t stateEntered[CAR_COUNT];
+static uint16_t hallUpSince[FLOOR_COUNT]; // 0.1 s stamps of pending hall calls
+static uint16_t hallDownSince[FLOOR_COUNT];
+static uint8_t dumpLine = DUMP_IDLE;
+
+static uint16_t now_tenths(void)
+{
+	return (uint16_t)(timer_millis() / 100);
+}
+
+void stats_init(void)
+{
+	memset(&stats, 0, sizeof(stats));
+	for (uint8_t car = 0; car < CAR_COUNT; car++)
+	{
+		stateEntered[car] = timer_millis();
+	}
+}
+
+void stats_state(uint8_t car, ElevatorState from)
+{
+	uint32_t now = timer_millis();
+
+	stats.stateMs[car][from] += now - stateEntered[car];
+	stateEntered[car] = now;
+}
+
+void stats_trip(void)
+{
+	stats.trips++;
+}
+
+void stats_floor(void)
+{
+	stats.floors++;
+}
+
+void stats_door_cycle(void)
+{
+	stats.doorCycles++;
+}
+
+void stats_emergency(void)
+{
+	stats.emergencies++;
+}
+
+void stats_call(uint8_t call)
+{
+	uint8_t floor = call & CALL_FLOOR_MASK;
+
+	if (floor >= FLOOR_COUNT)
+	{
+		return;
+	}
+	if ((call & CALL_TYPE_MASK) == CALL_HALL_UP)
+	{
+		hallUpSince[floor] = now_tenths();
+	}
+	else if ((call & CALL_TYPE_MASK) == CALL_HALL_DOWN)
+	{
+		hallDownSince[floor] = now_tenths();
+	}
+}
+
+void stats_pickup(uint8_t call)
+{
+	uint8_t floor = call & CALL_FLOOR_MASK;
+	uint16_t wait = now_tenths() - (((call & CALL_TYPE_MASK) == CALL_HALL_UP) ? hallUpSince[floor] : hallDownSince[floor]);
+	uint8_t bucket = 0;
+
+	while ((bucket < STATS_WAIT_BUCKETS - 1) && (wait >= pgm_read_byte(&waitLimits[bucket]) * 10U))
+	{
+		bucket++; // At most STATS_WAIT_BUCKETS steps
+	}
+	stats.waitHist[bucket]++;
+	stats.waitSum += wait;
+	if (wait > stats.waitMax)
+	{
+		stats.waitMax = wait;
+	}
+}
+
+void stats_dump(void)
+{
+	uint32_t now = timer_millis();
+
+	snapshot = stats;
+	for (uint8_t car = 0; car < CAR_COUNT; car++)
+	{
+		snapshot.stateMs[car][elevator_state(car)] += now - stateEntered[car]; // Time in the current state so far
+	}
+	dumpLine = 0;
+}
+
+void stats_task(void)
+{
+	uint8_t line = dumpLine;
+	uint16_t pickups = 0;
+
+	if (line == DUMP_IDLE)
+	{
+		return;
+	}
+	dumpLine = (line + 1 < DUMP_LINES) ? (line + 1) : DUMP_IDLE;
+
+	if (line == 0)
+	{
+		printf_P(PSTR("Trips %u floors %lu doors %u emergencies %u\n"), snapshot.trips, snapshot.floors,
+				 snapshot.doorCycles, snapshot.emergencies);
+		return;
+	}
+	line--;
+
+	if (line < DUMP_STATE_LINES)
+	{
+		uint32_t ms = snapshot.stateMs[line / STATE_COUNT][line % STATE_COUNT];
+
+		printf_P(PSTR("Car %u %S %lu.%lus\n"), line / STATE_COUNT, elevator_state_name(line % STATE_COUNT), ms / 1000,
+				 (ms % 1000) / 100);
+		return;
+	}
+	line -= DUMP_STATE_LINES;
+
+	if (line < STATS_WAIT_BUCKETS - 1)
+	{
+		printf_P(PSTR("Wait <%us %u\n"), pgm_read_byte(&waitLimits[line]), snapshot.waitHist[line]);
+		return;
+	}
+	if (line == STATS_WAIT_BUCKETS - 1)
+	{
+		printf_P(PSTR("Wait >=%us %u\n"), pgm_read_byte(&waitLimits[line - 1]), snapshot.waitHist[line]);
+		return;
+	}
+
+	for (uint8_t i = 0; i < STATS_WAIT_BUCKETS; i++)
+	{
+		pickups += snapshot.waitHist[i];
+	}
+	if (pickups > 0)
+	{
+		uint16_t mean = snapshot.waitSum / pickups;
+
+		printf_P(PSTR("Wait mean %u.%us max %u.%us\n"), mean / 10, mean % 10, snapshot.waitMax / 10,
+				 snapshot.waitMax % 10);
+	}
+}
@@ -0,0 +1,48 @@
+/*
+ * stats.h
+ *
+ * Created: 16.10.2026
+ *
+ * Runtime statistics: time in each FSM state per car, trips, floors
+ * travelled, door cycles, emergencies and a histogram of how long hall
+ * calls wait for a car. Every update is O(1) from the FSM, the report is
+ * printed one line per scheduler pass from a snapshot.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include "elevator.h"
+
+#define STATS_WAIT_BUCKETS 8 // Limits in stats.c
+
+typedef struct __attribute__((packed))
+{
+	uint32_t stateMs[CAR_COUNT][STATE_COUNT];
+	uint32_t floors;   // Landings passed
+	uint32_t waitSum;  // 0.1 s, for the mean
+	uint16_t waitMax;  // 0.1 s
+	uint16_t waitHist[STATS_WAIT_BUCKETS];
+	uint16_t trips;
+	uint16_t doorCycles;
+	uint16_t emergencies;
+} Stats;
+
+void stats_init(void);
+
+void stats_state(uint8_t car, ElevatorState from); // Car leaves from
+void stats_trip(void);
+void stats_floor(void);
+void stats_door_cycle(void);
+void stats_emergency(void);
+
+// Hall call registered / picked up, call is CALL_HALL_xxx | floor
+void stats_call(uint8_t call);
+void stats_pickup(uint8_t call);
+
+// Start printing the statistics over UART
+void stats_dump(void);
+void stats_task(void); // Every scheduler pass, prints one line while dumping
+
+#endif // STATS_H
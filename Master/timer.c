@@ -0,0 +1,55 @@
+/*
+ * timer.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "timer.h"
+#include "emergency.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+static volatile uint32_t millisCount = 0; // Incremented by the compare match ISR
+
+void timer_init(void)
+{
+	TCCR0A = (1 << WGM01);				 // CTC mode, TOP = OCR0A
+	TCCR0B = (1 << CS01) | (1 << CS00);	 // Prescaler 64 -> 250 kHz timer clock
+	OCR0A = (F_CPU / 64 / 1000) - 1;	 // 250 counts = 1 ms
+	TCNT0 = 0;
+	TIMSK0 |= (1 << OCIE0A);			 // Enable compare match A interrupt
+}
+
+uint32_t timer_millis(void)
+{
+	uint32_t ms;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // 32-bit read is not atomic on AVR
+	{
+		ms = millisCount;
+	}
+	return ms;
+}
+
+uint32_t timer_micros(void)
+{
+	uint32_t ms;
+	uint8_t ticks;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ms = millisCount;
+		ticks = TCNT0;
+		if ((TIFR0 & (1 << OCF0A)) && (ticks < OCR0A))
+		{
+			ms++; // Compare match happened but the ISR has not run yet
+		}
+	}
+	return (ms * 1000UL) + ((uint32_t)ticks * 4UL); // One timer count is 4 us
+}
+
+ISR(TIMER0_COMPA_vect)
+{
+	millisCount++;
+	emergency_sample(); // PA0 cannot interrupt, poll it here
+}
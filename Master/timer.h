@@ -0,0 +1,25 @@
+/*
+ * timer.h
+ *
+ * Created: 16.10.2026
+ *
+ * Millisecond timebase for the Master. Timer0 runs in CTC mode and
+ * interrupts once every millisecond.
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+void timer_init(void);
+
+// Milliseconds since timer_init(), wraps after ~49 days
+uint32_t timer_millis(void);
+
+// Microseconds since timer_init() with 4 us resolution, wraps after ~71 minutes.
+// Safe to call from an ISR.
+uint32_t timer_micros(void);
+
+#endif // TIMER_H
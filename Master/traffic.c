@@ -0,0 +1,226 @@
+/*
+ * traffic.c
+ *
+ * Created: 16.10.2026
+ */
+
+#include "traffic.h"
+#include "calls.h"
+#include "timer.h"
+#include "eventlog.h"
+#include "console.h"
+#include <avr/pgmspace.h>
+#include <stdio.h>
+
+#define TRAFFIC_WINDOW_MASK (TRAFFIC_WINDOW - 1)
+
+typedef enum
+{
+	FLOW_INTER, // Neither from nor to the lobby
+	FLOW_UP,	// Out of the lobby
+	FLOW_DOWN	// Towards the lobby
+} Flow;
+
+typedef struct
+{
+	uint32_t time; // timer_millis() of the call
+	uint8_t flow;  // Flow
+	uint8_t floor; // Landing the passenger waits at
+} TrafficSample;
+
+static TrafficSample window[TRAFFIC_WINDOW];
+static uint8_t head = 0;  // Next free entry
+static uint8_t count = 0; // Entries in use, the oldest is head - count
+static TrafficMode mode = TRAFFIC_INTERFLOOR;
+static TrafficPolicy policy = TRAFFIC_POLICY;
+
+static const char modeInterfloor[] PROGMEM = "INTERFLOOR";
+static const char modeUpPeak[] PROGMEM = "UP_PEAK";
+static const char modeDownPeak[] PROGMEM = "DOWN_PEAK";
+
+static PGM_P const modeNames[TRAFFIC_MODE_COUNT] PROGMEM = {modeInterfloor, modeUpPeak, modeDownPeak};
+
+static const char policyLook[] PROGMEM = "look";
+static const char policyLobby[] PROGMEM = "lobby";
+static const char policyZone[] PROGMEM = "zone";
+static const char policyAuto[] PROGMEM = "auto";
+
+static PGM_P const policyNames[POLICY_COUNT] PROGMEM = {
+	[POLICY_LOOK] = policyLook,
+	[POLICY_LOBBY_RETURN] = policyLobby,
+	[POLICY_ZONED] = policyZone,
+	[POLICY_AUTO] = policyAuto,
+};
+
+// Maps the detected mode to the policy POLICY_AUTO follows
+static const uint8_t modePolicy[TRAFFIC_MODE_COUNT] PROGMEM = {
+	[TRAFFIC_INTERFLOOR] = POLICY_LOOK,
+	[TRAFFIC_UP_PEAK] = POLICY_LOBBY_RETURN,
+	[TRAFFIC_DOWN_PEAK] = POLICY_ZONED,
+};
+
+void traffic_init(void)
+{
+	head = 0;
+	count = 0;
+	mode = TRAFFIC_INTERFLOOR;
+	policy = TRAFFIC_POLICY;
+}
+
+void traffic_record_call(uint8_t call, uint8_t carFloor)
+{
+	uint8_t floor = call & CALL_FLOOR_MASK;
+	TrafficSample *s = &window[head];
+
+	s->time = timer_millis();
+	s->flow = FLOW_INTER;
+	s->floor = floor;
+	switch (call & CALL_TYPE_MASK)
+	{
+	case CALL_HALL_UP:
+		if (floor == TRAFFIC_LOBBY_FLOOR)
+		{
+			s->flow = FLOW_UP;
+		}
+		break;
+	case CALL_HALL_DOWN:
+		s->flow = FLOW_DOWN; // Down hall calls nearly all end in the lobby
+		break;
+	default: // Car call, the passenger boarded at carFloor
+		s->floor = carFloor;
+		if (carFloor == TRAFFIC_LOBBY_FLOOR)
+		{
+			s->flow = FLOW_UP;
+		}
+		else if (floor == TRAFFIC_LOBBY_FLOOR)
+		{
+			s->flow = FLOW_DOWN;
+		}
+		break;
+	}
+
+	head = (head + 1) & TRAFFIC_WINDOW_MASK;
+	if (count < TRAFFIC_WINDOW)
+	{
+		count++;
+	}
+}
+
+// Drop the samples that slid out of the time window
+static void expire(uint32_t now)
+{
+	while (count > 0)
+	{
+		TrafficSample *s = &window[(head - count) & TRAFFIC_WINDOW_MASK];
+
+		if ((now - s->time) < TRAFFIC_WINDOW_MS)
+		{
+			break;
+		}
+		count--;
+	}
+}
+
+TrafficMode traffic_mode(void)
+{
+	uint8_t up = 0;
+	uint8_t down = 0;
+	TrafficMode next = TRAFFIC_INTERFLOOR;
+
+	expire(timer_millis());
+	for (uint8_t n = 0, i = (head - count) & TRAFFIC_WINDOW_MASK; n < count; n++, i = (i + 1) & TRAFFIC_WINDOW_MASK)
+	{
+		if (window[i].flow == FLOW_UP)
+		{
+			up++;
+		}
+		else if (window[i].flow == FLOW_DOWN)
+		{
+			down++;
+		}
+	}
+
+	// Hysteresis: staying in a peak mode takes a smaller share than entering it
+	if (count >= TRAFFIC_MIN_CALLS)
+	{
+		uint8_t upLimit = (mode == TRAFFIC_UP_PEAK) ? TRAFFIC_LEAVE_PERCENT : TRAFFIC_ENTER_PERCENT;
+		uint8_t downLimit = (mode == TRAFFIC_DOWN_PEAK) ? TRAFFIC_LEAVE_PERCENT : TRAFFIC_ENTER_PERCENT;
+
+		if ((up * 100U >= upLimit * (uint16_t)count) && (up >= down))
+		{
+			next = TRAFFIC_UP_PEAK;
+		}
+		else if (down * 100U >= downLimit * (uint16_t)count)
+		{
+			next = TRAFFIC_DOWN_PEAK;
+		}
+	}
+
+	if (next != mode)
+	{
+		if (CONSOLE_VERBOSE(CONSOLE_INFO))
+		{
+			printf_P(PSTR("Traffic %S -> %S (%u up, %u down of %u)\n"), (PGM_P)pgm_read_word(&modeNames[mode]),
+					 (PGM_P)pgm_read_word(&modeNames[next]), up, down, count);
+		}
+		eventlog_write(LOG_TRAFFIC_MODE, 0, next, 0);
+		mode = next;
+	}
+	return mode;
+}
+
+void traffic_set_policy(TrafficPolicy p)
+{
+	policy = p;
+}
+
+TrafficPolicy traffic_selected_policy(void)
+{
+	return policy;
+}
+
+PGM_P traffic_policy_name(TrafficPolicy p)
+{
+	return (PGM_P)pgm_read_word(&policyNames[p]);
+}
+
+TrafficPolicy traffic_policy_find(const char *name)
+{
+	uint8_t p;
+
+	for (p = 0; p < POLICY_COUNT; p++)
+	{
+		if (strcmp_P(name, traffic_policy_name(p)) == 0)
+		{
+			break;
+		}
+	}
+	return (TrafficPolicy)p;
+}
+
+TrafficPolicy traffic_policy(void)
+{
+	TrafficMode m = traffic_mode(); // Keep the mode and its log current even with a fixed policy
+
+	if (policy != POLICY_AUTO)
+	{
+		return policy;
+	}
+	return (TrafficPolicy)pgm_read_byte(&modePolicy[m]);
+}
+
+uint8_t traffic_zone_floor(void)
+{
+	uint16_t sum = 0;
+	uint8_t n = 0;
+
+	for (uint8_t k = 0, i = (head - count) & TRAFFIC_WINDOW_MASK; k < count; k++, i = (i + 1) & TRAFFIC_WINDOW_MASK)
+	{
+		if (window[i].flow == FLOW_DOWN)
+		{
+			sum += window[i].floor;
+			n++;
+		}
+	}
+	return (n > 0) ? (uint8_t)((sum + n / 2) / n) : TRAFFIC_LOBBY_FLOOR;
+}
@@ -0,0 +1,66 @@
+/*
+ * traffic.h
+ *
+ * Created: 16.10.2026
+ *
+ * Traffic mode detection. Recent calls are kept in a sliding window and
+ * classified as up-peak (passengers leaving the lobby), down-peak (heading
+ * for the lobby) or interfloor traffic. The mode selects the policy the idle
+ * car follows; dispatch of pending calls is LOOK in every mode.
+ */
+
+#ifndef TRAFFIC_H
+#define TRAFFIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+
+#define TRAFFIC_LOBBY_FLOOR 0
+#define TRAFFIC_WINDOW 16			// Calls in the window, power of two
+#define TRAFFIC_WINDOW_MS 300000UL	// Calls older than this are forgotten
+#define TRAFFIC_MIN_CALLS 6			// Fewer calls in the window is interfloor
+#define TRAFFIC_ENTER_PERCENT 60	// Share of lobby calls to enter a peak mode
+#define TRAFFIC_LEAVE_PERCENT 40	// Share below which a peak mode is left
+
+typedef enum
+{
+	TRAFFIC_INTERFLOOR,
+	TRAFFIC_UP_PEAK,
+	TRAFFIC_DOWN_PEAK,
+	TRAFFIC_MODE_COUNT
+} TrafficMode;
+
+typedef enum
+{
+	POLICY_LOOK,		 // Park at the floor with the highest learned demand
+	POLICY_LOBBY_RETURN, // Return to the lobby at once
+	POLICY_ZONED,		 // Park in the zone the down calls come from
+	POLICY_AUTO,		 // Follow the detected traffic mode
+	POLICY_COUNT
+} TrafficPolicy;
+
+// Policy used from boot, POLICY_AUTO or one of the fixed policies. The
+// "policy" console command changes it at runtime.
+#ifndef TRAFFIC_POLICY
+#define TRAFFIC_POLICY POLICY_AUTO
+#endif
+
+void traffic_init(void);
+
+// Add a call encoded as CALL_xxx | floor, entered with the car at carFloor
+void traffic_record_call(uint8_t call, uint8_t carFloor);
+
+// Mode of the current window, logs the change over UART when it switches
+TrafficMode traffic_mode(void);
+
+void traffic_set_policy(TrafficPolicy policy);
+TrafficPolicy traffic_selected_policy(void); // As set, may be POLICY_AUTO
+TrafficPolicy traffic_policy(void);			 // Policy in effect, never POLICY_AUTO
+TrafficPolicy traffic_policy_find(const char *name); // "look", "lobby", "zone" or "auto", POLICY_COUNT if none
+PGM_P traffic_policy_name(TrafficPolicy policy);
+
+// Average landing the down-peak calls come from
+uint8_t traffic_zone_floor(void);
+
+#endif // TRAFFIC_H
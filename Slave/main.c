@@ -12,13 +12,84 @@
 #define BAUD 9600
 
 #define MYUBBR (FOSC/16/BAUD-1) // baud rate register value, datasheet p.203, 226
-#define SLAVE_ADDRESS 0b1010111 // 87 as decimal. Address must be same as masters address
+// Car number in the group, build each car's Slave with -DCAR_ID=n
+#ifndef CAR_ID
+#define CAR_ID 0
+#endif
+// A landing indicator is built with -DLANDING_FLOOR=n and shows car CAR_ID
+// from the position broadcasts: door LED while the car is at floor n
+// (arrival lantern), movement LED while it travels
+#define LANDING_NONE 0xFF
+#ifndef LANDING_FLOOR
+#define LANDING_FLOOR LANDING_NONE
+#endif
+#if LANDING_FLOOR == LANDING_NONE
+#define SLAVE_ADDRESS (0b1010111 + CAR_ID) // 87 as decimal for car 0. Address must match the masters SLAVE_ADDRESS + car
+#else
+#define SLAVE_ADDRESS (0x10 + LANDING_FLOOR) // Not used by the Master, landings only listen to the general call
+#endif
 
 #include <avr/io.h>
 #include <util/delay.h>
 #include <util/setbaud.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <util/atomic.h>
+#include <string.h>
+#include "../Common/protocol.h"
+#include "../Common/ringbuf.h"
+
+// Timing parameters set by the Master with PROTO_SET_PARAM
+#define PARAMS_VERSION 1
+#define PARAMS_ADDR ((void *)0) // Start of the EEPROM
+#define STACK_CANARY 0xC5
+#define TWI_TIMEOUT_MS 10 // Longest the Master may stall inside a frame
+#define ATTN_PIN PD4	  // Open drain attention line to the Master's INT2, low = asserted
+#define TWI_ACK ((1 << TWINT) | (1 << TWEA) | (1 << TWEN) | (1 << TWIE))
+#define TWI_NACK ((1 << TWINT) | (1 << TWEN) | (1 << TWIE)) // Refuse the next byte, or send the last one
+
+// Provided by the avr-libc linker script
+extern uint8_t __data_start;
+extern uint8_t __data_end;
+extern uint8_t __bss_start;
+extern uint8_t __bss_end;
+extern uint8_t __heap_start;
+
+typedef struct
+{
+    uint8_t version;
+    uint16_t values[PROTO_PARAM_COUNT];
+    uint8_t crc; // CRC-8 of everything above
+} ParamBlock;
+
+static const uint16_t paramDefaults[PROTO_PARAM_COUNT] = {300, 500, 2000};
+static uint16_t params[PROTO_PARAM_COUNT];
+// A frame as received by the TWI interrupt
+typedef struct
+{
+    bool broadcast; // Came to the general call address
+    uint8_t len;
+    uint8_t data[PROTO_FRAME_MAX];
+} Frame;
+
+RINGBUF_DEFINE(frames, Frame, 4);
+
+static frames_t frameQueue; // TWI_vect -> main loop
+static uint8_t lastSeq = PROTO_SEQ_RESYNC; // Of the last frame carried out
+static uint8_t lastBroadcastSeq = PROTO_SEQ_RESYNC;
+static uint8_t effect = PROTO_EFFECT_NONE;
+static bool effectEnded = false;		  // Report PROTO_ATTN_DONE once the queue is empty
+static volatile uint8_t attention = 0;	  // PROTO_ATTN_* not read by the Master yet
+static uint16_t badFrames = 0;
+static volatile uint16_t dropped = 0;	  // Frames too long to keep, counted by the ISR
+static volatile uint16_t busErrors = 0;	  // Illegal START or STOP seen on the bus
+static volatile uint16_t twiTimeouts = 0; // Frames abandoned by the Master halfway
+static volatile bool addressed = false;	  // Between SLA+W or SLA+R and the end of the transfer
+static volatile uint8_t stalled = 0;	  // ms since the last TWI event
+static volatile uint8_t statusBlock[PROTO_STATUS_LEN]; // Returned for SLA+R
 
 
 // USART setup for debug output (unchanged)
@@ -48,8 +119,289 @@ static char USART_Receive(FILE *stream) //datasheet p.210, 219
 	return UDR0;
 }
 
-// Emergency sequence
-void emergency(void)
+static uint8_t outputs(void)
+{
+    uint8_t out = 0;
+
+    if (PORTB & (1 << PB0)) {
+        out |= PROTO_OUT_MOVE;
+    }
+    if (PORTD & (1 << PD7)) {
+        out |= PROTO_OUT_DOOR;
+    }
+    if (TCCR1A & (1 << 6)) { // OC1A drives the buzzer
+        out |= PROTO_OUT_BUZZER;
+    }
+    return out;
+}
+
+static void put16(uint8_t offset, uint16_t value)
+{
+    statusBlock[offset] = value & 0xFF;
+    statusBlock[offset + 1] = value >> 8;
+}
+
+// Rebuilds the status block the TWI interrupt hands to a reading Master.
+// Interrupts are off while it changes, a read always gets a whole block.
+static void status_update(void)
+{
+    uint8_t crc = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        statusBlock[PROTO_STATUS_OUTPUTS] = outputs();
+        statusBlock[PROTO_STATUS_EFFECT] = effect;
+        statusBlock[PROTO_STATUS_SEQ] = lastSeq;
+        statusBlock[PROTO_STATUS_QUEUED] = frames_count(&frameQueue);
+        put16(PROTO_STATUS_BAD_FRAMES, badFrames);
+        put16(PROTO_STATUS_DROPPED, dropped);
+        put16(PROTO_STATUS_BUS_ERRORS, busErrors);
+        put16(PROTO_STATUS_TIMEOUTS, twiTimeouts);
+        statusBlock[PROTO_STATUS_ATTENTION] = attention;
+        for (uint8_t i = 0; i < PROTO_STATUS_CRC; i++) {
+            crc = _crc8_ccitt_update(crc, statusBlock[i]);
+        }
+        statusBlock[PROTO_STATUS_CRC] = crc;
+    }
+}
+
+// Pulls the attention line and puts the reason in the status block, in
+// one step so a read in between cannot release the line without the reason
+static void raise_attention(uint8_t reason)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        attention |= reason;
+        DDRD |= (1 << ATTN_PIN);
+        status_update();
+    }
+}
+
+// _delay_ms() needs a constant, the parameters are not. The status block
+// is kept current while an effect waits.
+static void delay_ms(uint16_t ms)
+{
+    while (ms--)
+    {
+        _delay_ms(1);
+        status_update();
+    }
+}
+
+static uint8_t params_crc(const ParamBlock *b)
+{
+    const uint8_t *p = (const uint8_t *)b;
+    uint8_t crc = 0;
+
+    for (uint8_t i = 0; i < sizeof(*b) - 1; i++)
+    {
+        crc = _crc8_ccitt_update(crc, p[i]);
+    }
+    return crc;
+}
+
+// Parameters from EEPROM, the defaults if the block is blank or damaged
+static void params_load(void)
+{
+    ParamBlock b;
+
+    eeprom_read_block(&b, PARAMS_ADDR, sizeof(b));
+    for (uint8_t i = 0; i < PROTO_PARAM_COUNT; i++)
+    {
+        params[i] = ((b.version == PARAMS_VERSION) && (params_crc(&b) == b.crc)) ? b.values[i] : paramDefaults[i];
+    }
+}
+
+static void params_set(uint8_t id, uint16_t value)
+{
+    ParamBlock b;
+
+    if ((id >= PROTO_PARAM_COUNT) || (params[id] == value))
+    {
+        return; // Unknown or unchanged, spare the EEPROM
+    }
+    params[id] = value;
+    b.version = PARAMS_VERSION;
+    for (uint8_t i = 0; i < PROTO_PARAM_COUNT; i++)
+    {
+        b.values[i] = params[i];
+    }
+    b.crc = params_crc(&b);
+    eeprom_update_block(&b, PARAMS_ADDR, sizeof(b));
+}
+
+// Paints the free RAM so the stack high-water mark can be found later.
+// Runs after .init2 has set up SP and before .data and .bss are filled.
+void stack_paint(void) __attribute__((naked, used, section(".init3")));
+void stack_paint(void)
+{
+    uint8_t *p = &__heap_start;
+
+    while (p < (uint8_t *)(uintptr_t)SP)
+    {
+        *p++ = STACK_CANARY;
+    }
+}
+
+// Static data, BSS and the deepest the stack has been. Only done on request,
+// the scan walks all of the free RAM.
+static void mem_report(void)
+{
+    uint8_t *edge = &__heap_start;
+    uint16_t drops, bus, timeouts;
+
+    while ((edge <= (uint8_t *)RAMEND) && (*edge == STACK_CANARY))
+    {
+        edge++;
+    }
+    printf("RAM data %u bss %u stack peak %u headroom %u\n", (uint16_t)(&__data_end - &__data_start),
+           (uint16_t)(&__bss_end - &__bss_start), (uint16_t)((uint8_t *)RAMEND + 1 - edge),
+           (uint16_t)(edge - &__heap_start));
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { // Counted by the ISRs
+        drops = dropped;
+        bus = busErrors;
+        timeouts = twiTimeouts;
+    }
+    printf("TWI bad frames %u dropped %u bus errors %u timeouts %u\n", badFrames, drops, bus, timeouts);
+}
+
+// Back to the not addressed slave state with the lines released, which
+// also throws away a half received byte
+static void twi_listen(void)
+{
+    TWCR = 0;
+    TWCR = TWI_ACK; // Enable TWI + ACK
+}
+
+// Receives frames straight into a free slot of frameQueue and answers
+// reads with the status block. A frame is only acknowledged while the
+// queue has room for it, otherwise the Master sees a NACK and sends it
+// again later.
+ISR(TWI_vect)
+{
+    static Frame *rx;    // Slot being received into, NULL if refused
+    static bool overrun; // More bytes than any frame has
+    static uint8_t tx[PROTO_STATUS_LEN]; // Status block being sent
+    static uint8_t txIndex;
+    uint8_t twcr = TWI_ACK;
+
+    stalled = 0;
+    switch (TWSR & 0xF8) {
+        case 0x60: // Own SLA+W, ACK returned
+        case 0x70: // General call, ACK returned
+            overrun = false;
+            addressed = true;
+            rx = frames_reserve(&frameQueue);
+            if (rx == NULL) {
+                twcr = TWI_NACK;
+                break;
+            }
+            rx->broadcast = ((TWSR & 0xF8) == 0x70);
+            rx->len = 0;
+            break;
+        case 0x80: // Data received, ACK returned
+        case 0x90:
+            if (rx->len < sizeof(rx->data)) {
+                rx->data[rx->len++] = TWDR;
+            }
+            else {
+                overrun = true;
+            }
+            break;
+        case 0x88: // Data received, NACK returned: frame refused
+        case 0x98:
+            addressed = false;
+            break;
+        case 0xA0: // STOP or repeated START, the frame is complete
+            if (rx != NULL) { // Not refused
+                if (overrun) {
+                    dropped++;
+                }
+                else if (rx->len > 0) {
+                    frames_commit(&frameQueue);
+                }
+            }
+            rx = NULL;
+            addressed = false;
+            break;
+        case 0xA8: // Own SLA+R, ACK returned
+            memcpy(tx, (const uint8_t *)statusBlock, sizeof(tx));
+            txIndex = 0;
+            addressed = true;
+            attention = 0; // The Master has the reason now
+            DDRD &= ~(1 << ATTN_PIN);
+            // fall through
+        case 0xB8: // Data sent, ACK received: the Master wants the next byte
+            TWDR = (txIndex < sizeof(tx)) ? tx[txIndex++] : 0xFF;
+            if (txIndex == sizeof(tx)) {
+                twcr = TWI_NACK; // Last byte
+            }
+            break;
+        case 0xC0: // Data sent, NACK received: the Master has enough
+        case 0xC8: // Last byte sent, ACK received
+            addressed = false;
+            break;
+        case 0x00: // Bus error, illegal START or STOP
+            busErrors++;
+            addressed = false;
+            twcr |= (1 << TWSTO); // Releases the lines, no STOP is sent
+            break;
+    }
+    TWCR = twcr;
+}
+
+// 1 ms tick, drops a transfer the Master left halfway so the bus and the
+// next frame are not blocked by it
+ISR(TIMER0_COMPA_vect)
+{
+    if (addressed && (++stalled >= TWI_TIMEOUT_MS)) {
+        twiTimeouts++;
+        addressed = false;
+        twi_listen();
+    }
+}
+
+static void tick_init(void)
+{
+    TCCR0A = (1 << WGM01);				   // CTC
+    OCR0A = (F_CPU / 64 / 1000) - 1;	   // 1 ms
+    TCCR0B = (1 << CS01) | (1 << CS00);	   // Prescaler 64
+    TIMSK0 = (1 << OCIE0A);
+}
+
+// Prints the TWI errors the interrupts counted since the last call and
+// tells the Master about any new error
+static void twi_log(void)
+{
+    static uint16_t seenBus = 0;
+    static uint16_t seenTimeouts = 0;
+    static uint16_t seenDropped = 0;
+    static uint16_t seenBad = 0;
+    uint16_t bus, timeouts, drops;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        bus = busErrors;
+        timeouts = twiTimeouts;
+        drops = dropped;
+    }
+    if ((bus != seenBus) || (timeouts != seenTimeouts) || (drops != seenDropped) || (badFrames != seenBad)) {
+        seenBad = badFrames;
+        raise_attention(PROTO_ATTN_FAULT);
+    }
+    if (bus != seenBus) {
+        seenBus = bus;
+        printf("TWI bus error\n");
+    }
+    if (timeouts != seenTimeouts) {
+        seenTimeouts = timeouts;
+        printf("TWI timeout\n");
+    }
+    if (drops != seenDropped) {
+        seenDropped = drops;
+        printf("Frame too long\n");
+    }
+}
+
+// Emergency sequence, a rising note per step
+void emergency(uint8_t notes)
 {
     
 	TCNT1 = 0; // Reset timer to zero
@@ -62,18 +414,18 @@ void emergency(void)
 	    
 	TIMSK1 |= (1 << 1); // Enable counter interrupt
 	     
-	sei();
+	effect = PROTO_EFFECT_EMERGENCY;
 	PORTD |= (1 << PD7); // Dooropen LED
     TCCR1B |= (1 << 1); // Prescaler set to 8
     
     uint16_t note = 1000; // Declaring a variable for emergency note
     PORTD |= (1 << PD7); // Dooropen
 
-    for (int i = 0; i < 6; i++) // Loop for playing emergency note
+    for (uint8_t i = 0; i < notes; i++) // Loop for playing emergency note
     {
         OCR1A = note; // Note frequency
         note = note+750; //Changing the note frequency
-        _delay_ms(500); //Wait for half a second
+        delay_ms(params[PROTO_PARAM_NOTE]); //Hold the note
     }    
          
 	// Disable all previously set settings
@@ -85,8 +437,10 @@ void emergency(void)
 	//Resetting timer registers
 	OCR1A = 0; //Set Output Compare register to 0
 	TCNT1 = 0; //Reset Counter1
-	_delay_ms(2000); //Wait for 2 seconds
+	delay_ms(params[PROTO_PARAM_HOLD]); //Keep the door open a while
     PORTD &= ~(1 << PD7); // Close door
+    effect = PROTO_EFFECT_NONE;
+    effectEnded = true;
 }
 
 ISR (TIMER1_COMPA_vect) {} //Define an interrupt service routine for Timer1
@@ -94,73 +448,155 @@ ISR (TIMER1_COMPA_vect) {} //Define an interrupt service routine for Timer1
 FILE uart_output = FDEV_SETUP_STREAM(USART_Transmit, NULL, _FDEV_SETUP_WRITE); //Defining custom output for stdio commands
 FILE uart_input = FDEV_SETUP_STREAM(NULL, USART_Receive, _FDEV_SETUP_READ); //Defining custom input for stdio commands
 
+// Position broadcast, sent for every car. Each node only keeps the car it
+// belongs to. A car Slave does not answer the general call and never gets here.
+static void position(uint8_t car, uint8_t floor, uint8_t dir)
+{
+    if (car != CAR_ID) {
+        return;
+    }
+#if LANDING_FLOOR != LANDING_NONE
+    if (floor == LANDING_FLOOR) {
+        PORTD |= (1 << PD7);
+    }
+    else {
+        PORTD &= ~(1 << PD7);
+    }
+    if (dir != PROTO_DIR_NONE) {
+        PORTB |= (1 << PB0);
+    }
+    else {
+        PORTB &= ~(1 << PB0);
+    }
+#endif
+}
+
+// Carries out one command, args points into the received frame
+static void execute(uint8_t opcode, const uint8_t *args)
+{
+    // React to master's command
+    switch (opcode) {
+        case PROTO_MOVE_ON: // Movement LED ON
+            PORTB |= (1 << PB0);
+            break;
+        case PROTO_MOVE_OFF: // Movement LED OFF
+            PORTB &= ~(1 << PB0);
+            break;
+        case PROTO_BLINK: // Blink movement LED (FAULT)
+            effect = PROTO_EFFECT_BLINK;
+            for (uint8_t i = 0; i < args[0]; i++) {
+                PORTB |= (1 << PB0); //Turn on LED
+                delay_ms(params[PROTO_PARAM_BLINK]);
+                PORTB &= ~(1 << PB0); //Turn off LED
+                delay_ms(params[PROTO_PARAM_BLINK]);
+            }
+            effect = PROTO_EFFECT_NONE;
+            effectEnded = true;
+            break;
+        case PROTO_DOOR_OPEN: // Door LED ON
+            PORTD |= (1 << PD7); 
+            break;
+        case PROTO_DOOR_CLOSE: // Door LED OFF
+            PORTD &= ~(1 << PD7);
+            break;
+        case PROTO_EMERGENCY: // Emergency routine
+            emergency(args[0]);
+            break;
+        case PROTO_SET_PARAM:
+            params_set(args[0], args[1] | (args[2] << 8));
+            break;
+        case PROTO_MEM_REPORT:
+            mem_report();
+            break;
+        case PROTO_POSITION:
+            position(args[0], args[1], args[2]);
+            break;
+    }
+}
+
+// Checks a frame of len bytes and carries out its commands, straight from
+// its slot in frameQueue. A broadcast only carries out PROTO_POSITION.
+static void process_frame(const uint8_t *frame, uint8_t len, bool broadcast)
+{
+    const uint8_t *p = frame + 2;
+    const uint8_t *end;
+    uint8_t *last = broadcast ? &lastBroadcastSeq : &lastSeq;
+    uint8_t crc = 0;
+
+    if ((len < PROTO_OVERHEAD) || (frame[1] != len - PROTO_OVERHEAD)) {
+        badFrames++;
+        printf("Bad frame length %d\n", len);
+        return;
+    }
+    for (uint8_t i = 0; i < len - 1; i++) {
+        crc = _crc8_ccitt_update(crc, frame[i]);
+    }
+    if (crc != frame[len - 1]) {
+        badFrames++;
+        printf("Bad frame CRC\n");
+        return;
+    }
+    if ((frame[0] != PROTO_SEQ_RESYNC) && (frame[0] == *last)) {
+        return; // Sent again by the Master, already carried out
+    }
+    *last = frame[0];
+
+    end = p + frame[1];
+    while (p < end) {
+        uint8_t opcode = *p++;
+        uint8_t argLen = proto_arg_len(opcode);
+
+        if ((argLen == 0xFF) || (argLen > end - p)) {
+            badFrames++;
+            printf("Bad command %d\n", opcode);
+            return;
+        }
+        if (!broadcast || (opcode == PROTO_POSITION)) {
+            execute(opcode, p);
+        }
+        p += argLen;
+    }
+}
+
 int main(void)
 {
     DDRB |= (1 << PB0);  // Movement LED
     DDRD |= (1 << PD7);  // Door LED
     DDRB |= (1 << PB5);  // Emergency LED
     DDRB |= (1 << PB1);  // Buzzer
+    PORTD &= ~(1 << ATTN_PIN); // Attention line, released (input) until there is news
 
+    params_load();
     USART_init(MYUBBR);  // Initializing the USART peripheral with a baud rate.
     stdout = &uart_output; //Redirecting the output stream to use the UART.
     stdin = &uart_input; // Redirecting input to read from the UART
 
     // Setup I²C as slave
-    TWAR = (SLAVE_ADDRESS << 1);             // Slave address
-    TWCR = (1 << TWEA) | (1 << TWEN);        // Enable TWI + ACK
+#if LANDING_FLOOR == LANDING_NONE
+    TWAR = (SLAVE_ADDRESS << 1); // Slave address. A car ignores the general call, the positions are for the landings
+#else
+    TWAR = (SLAVE_ADDRESS << 1) | (1 << TWGCE); // Slave address, and answer the general call
+#endif
+    frames_init(&frameQueue);
+    status_update();
+    twi_listen();
+    tick_init();
+    sei();
 
-    uint8_t twi_receive_data = 0; // Comes from Master
-	uint8_t twi_send_data = 1; // Data sent to Master
-    uint8_t twi_status = 0; 
+    Frame *frame;
 
     while (1) {
-        while (!(TWCR & (1 << TWINT))) {;}   // Wait for TWI interrupt flag
-
-        twi_status = (TWSR & 0xF8); // Mask prescaler bits
-
-        if ((twi_status == 0x80) || (twi_status == 0x90)) { //If data has been received and ACK returned
-            twi_receive_data = TWDR; //Store the received data in twi_receive_data
-            printf("%d\n", twi_receive_data); // Transmission test print
-
-            // React to master's command
-            switch (twi_receive_data) {
-                case 0x01: // Movement LED ON
-                    PORTB |= (1 << PB0);
-                    break;
-                case 0x02: // Movement LED OFF
-                    PORTB &= ~(1 << PB0);
-                    break;
-                case 0x03: // Blink movement LED 3x (FAULT)
-                    for (int i = 0; i < 3; i++) {
-                        PORTB |= (1 << PB0); //Turn on LED
-                        _delay_ms(300);
-                        PORTB &= ~(1 << PB0); //Turn off LED
-                        _delay_ms(300);
-                    }
-                    break;
-                case 0x04: // Door LED ON
-                    PORTD |= (1 << PD7); 
-                    break;
-                case 0x05: // Door LED OFF
-                    PORTD &= ~(1 << PD7);
-                    break;
-                case 0x06: // Emergency routine
-                    emergency();
-                    break;
-            }
-        }
-        else if ((twi_status == 0x88) || (twi_status == 0x98)) {
-            // Data received but NACK'd
-            twi_receive_data = TWDR; //Read the received byte
-            printf("NACK"); //Print "NACK"
-            printf("%d\n", twi_receive_data); //Print the received byte
+        frame = frames_peek(&frameQueue);
+        if (frame != NULL) {
+            process_frame(frame->data, frame->len, frame->broadcast);
+            frames_drop(&frameQueue); // Only now may the ISR receive into the slot
         }
-        else if (twi_status == 0xA0) {
-            // STOP condition received
-            TWCR |= (1 << TWINT); //Setting a TWINT flag
+        else if (effectEnded) { // Idle again, the Master can stop waiting
+            effectEnded = false;
+            raise_attention(PROTO_ATTN_DONE);
         }
-
-        TWCR |= (1 << TWINT) | (1 << TWEA) | (1 << TWEN); // Resume listening
+        status_update();
+        twi_log();
     }
 
     return 0;